@@ -0,0 +1,113 @@
+/*
+	Example reader for the Rate Viewer's shared-memory rate snapshots.
+
+	Build (Linux):  cc -std=c11 -O2 -I../Source rate_snapshot_reader.c -o rate_snapshot_reader -lrt
+	Build (macOS):  cc -std=c11 -O2 -I../Source rate_snapshot_reader.c -o rate_snapshot_reader
+
+	Run while the Rate Viewer has "publish_rates" set to "Shared memory",
+	passing the viewer's node id (the object name is logged when publishing
+	starts), or a full object name starting with '/'. Prints the newest
+	snapshot's sequence, timestamp and busiest channel ten times per second.
+*/
+
+/* shm_open, nanosleep and friends are POSIX, not C11 */
+#define _DEFAULT_SOURCE
+
+#include "RateSnapshotShm.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <node id | /object name>\n", argv[0]);
+		return 1;
+	}
+
+	char name[256];
+
+	if (argv[1][0] == '/')
+		snprintf(name, sizeof(name), "%s", argv[1]);
+	else
+		snprintf(name, sizeof(name), "%s_%s", RV_SHM_NAME_PREFIX, argv[1]);
+
+	int fd = shm_open(name, O_RDONLY, 0);
+
+	if (fd < 0)
+	{
+		perror("shm_open");
+		return 1;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(rv_shm_header))
+	{
+		fprintf(stderr, "%s is not a rate snapshot ring\n", name);
+		return 1;
+	}
+
+	const void* base = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+
+	const rv_shm_header* header = (const rv_shm_header*) base;
+	float* rates = (float*) malloc(header->max_channels * sizeof(float));
+	uint64_t lastSequence = 0;
+
+	for (;;)
+	{
+		rv_shm_slot slot;
+		const int count = rv_shm_read_latest(base, &slot, rates, header->max_channels);
+
+		if (count < 0)
+		{
+			fprintf(stderr, "unexpected ring version\n");
+			return 1;
+		}
+
+		if (count > 0 && slot.sequence != lastSequence)
+		{
+			int busiest = 0;
+			double total = 0.0;
+
+			for (int ch = 0; ch < count; ++ch)
+			{
+				total += rates[ch];
+
+				if (rates[ch] > rates[busiest])
+					busiest = ch;
+			}
+
+			printf("#%llu  sample %lld @ %.0f Hz  %d channels  mean %.2f Hz  max ch %d (%.2f Hz)",
+			       (unsigned long long) slot.sequence,
+			       (long long) slot.sample_number,
+			       slot.sample_rate,
+			       count,
+			       total / count,
+			       busiest,
+			       rates[busiest]);
+
+			if (lastSequence != 0 && slot.sequence > lastSequence + 1)
+				printf("  (%llu skipped)", (unsigned long long) (slot.sequence - lastSequence - 1));
+
+			printf("\n");
+			lastSequence = slot.sequence;
+		}
+
+		const struct timespec interval = { 0, 100000000L };
+		nanosleep(&interval, NULL);
+	}
+}
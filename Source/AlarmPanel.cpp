@@ -0,0 +1,359 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AlarmPanel.h"
+
+namespace
+{
+    /** Orders alarms by the most severe flag, then by how many are set */
+    int getSeverity(uint8 flags)
+    {
+        const int worst = (flags & ChannelAlarmMonitor::runaway)  ? 3
+                        : (flags & ChannelAlarmMonitor::rateHigh) ? 2
+                        : (flags & ChannelAlarmMonitor::silent)   ? 1
+                                                                  : 0;
+
+        return worst * 8 + flags;
+    }
+}
+
+AlarmPanel::ThresholdLabel::ThresholdLabel(AlarmPanel& owner_)
+    : owner(owner_)
+{
+    setEditable(false, true, false);
+    setJustificationType(Justification::centredRight);
+    setColour(Label::textColourId, Colours::white);
+}
+
+void AlarmPanel::ThresholdLabel::setRow(int key_)
+{
+    key = key_;
+
+    const float threshold = owner.getRowThreshold(key);
+    setText(threshold > 0.0f ? String(threshold, 1) : "-", dontSendNotification);
+}
+
+void AlarmPanel::ThresholdLabel::textWasEdited()
+{
+    owner.setRowThreshold(key, getText().getFloatValue());
+    setRow(key);
+}
+
+AlarmPanel::AlarmPanel(ChannelAlarmMonitor& monitor_, std::function<float(int)> getRate_)
+    : monitor(monitor_), getRate(std::move(getRate_))
+{
+    // Forces the first updateRows() to copy the settings
+    settingsVersion = monitor.getSettingsVersion() - 1;
+
+    auto& header = table.getHeader();
+    header.addColumn("Channel", channelColumn, 80);
+    header.addColumn("Alarm", alarmColumn, 90);
+    header.addColumn("Rate", rateColumn, 50);
+    header.addColumn("Limit", thresholdColumn, 50);
+    header.addColumn("Since", sinceColumn, 50);
+    header.setSortColumnId(alarmColumn, false);
+
+    table.setModel(this);
+    table.setRowHeight(18);
+    table.setColour(ListBox::backgroundColourId, Colour(20, 20, 20));
+    addAndMakeVisible(table);
+
+    updateRows();
+}
+
+Colour AlarmPanel::getAlarmColour(uint8 flags)
+{
+    if (flags & ChannelAlarmMonitor::runaway)
+        return Colours::magenta;
+
+    if (flags & ChannelAlarmMonitor::rateHigh)
+        return Colours::orange;
+
+    if (flags & ChannelAlarmMonitor::silent)
+        return Colours::lightblue;
+
+    return Colours::transparentBlack;
+}
+
+String AlarmPanel::getAlarmText(uint8 flags)
+{
+    StringArray parts;
+
+    if (flags & ChannelAlarmMonitor::rateHigh)
+        parts.add("High");
+
+    if (flags & ChannelAlarmMonitor::silent)
+        parts.add("Silent");
+
+    if (flags & ChannelAlarmMonitor::runaway)
+        parts.add("Runaway");
+
+    return parts.joinIntoString(", ");
+}
+
+void AlarmPanel::resized()
+{
+    table.setBounds(getLocalBounds());
+}
+
+uint8 AlarmPanel::getRowFlags(int key) const
+{
+    return isGroup(key) ? monitor.getGroupFlags(key - numChannels) : monitor.getFlags(key);
+}
+
+float AlarmPanel::getRowRate(int key) const
+{
+    if (! isGroup(key))
+        return getRate(key);
+
+    const auto& group = settings.groups[(size_t) (key - numChannels)];
+    float sum = 0.0f;
+
+    for (int ch : group.channels)
+        sum += ch >= 0 && ch < numChannels ? getRate(ch) : 0.0f;
+
+    return group.channels.empty() ? 0.0f : sum / group.channels.size();
+}
+
+float AlarmPanel::getRowThreshold(int key) const
+{
+    if (isGroup(key))
+        return settings.groups[(size_t) (key - numChannels)].threshold;
+
+    if (key < (int) settings.channelThresholds.size() && settings.channelThresholds[(size_t) key] > 0.0f)
+        return settings.channelThresholds[(size_t) key];
+
+    return settings.alarmRate;
+}
+
+void AlarmPanel::setRowThreshold(int key, float threshold)
+{
+    if (isGroup(key))
+        monitor.setGroupThreshold(key - numChannels, threshold);
+    else
+        monitor.setChannelThreshold(key, threshold);
+
+    updateRows();
+    table.repaint();
+}
+
+void AlarmPanel::updateRows()
+{
+    // Polled twice a second during acquisition, so the settings are only copied after a change
+    const uint32 version = monitor.getSettingsVersion();
+
+    if (version != settingsVersion)
+    {
+        settingsVersion = version;
+        monitor.copySettings(settings);
+    }
+
+    const int newChannels = monitor.getNumChannels();
+    const int newGroups = jmin(ChannelAlarmMonitor::maxGroups, (int) settings.groups.size());
+
+    if (newChannels != numChannels || newGroups != numGroups)
+    {
+        numChannels = newChannels;
+        numGroups = newGroups;
+
+        const int numRows = numChannels + numGroups;
+        rows.resize((size_t) numRows);
+
+        for (int i = 0; i < numRows; ++i)
+            rows[(size_t) i] = i;
+
+        selectedKey = -1;
+        shownFlags.assign((size_t) numRows, 0);
+        alarmSince.assign((size_t) numRows, 0);
+        table.updateContent();
+    }
+}
+
+void AlarmPanel::alarmsChanged()
+{
+    updateRows();
+
+    const int64 now = Time::getMillisecondCounter();
+
+    for (int key = 0; key < (int) shownFlags.size(); ++key)
+    {
+        const uint8 flags = getRowFlags(key);
+
+        if (flags != shownFlags[(size_t) key])
+        {
+            // Only a newly raised alarm restarts the clock
+            if ((flags & ~shownFlags[(size_t) key]) != 0)
+                alarmSince[(size_t) key] = now;
+
+            shownFlags[(size_t) key] = flags;
+        }
+    }
+
+    sortRows();
+}
+
+void AlarmPanel::updateRates()
+{
+    updateRows();
+    sortRows();
+}
+
+void AlarmPanel::sortRows()
+{
+    auto compare = [this](int a, int b) -> bool
+    {
+        switch (sortColumn)
+        {
+            case alarmColumn:
+                return getSeverity(shownFlags[(size_t) a]) < getSeverity(shownFlags[(size_t) b]);
+            case rateColumn:
+                return getRowRate(a) < getRowRate(b);
+            case thresholdColumn:
+                return getRowThreshold(a) < getRowThreshold(b);
+            case sinceColumn:
+                return alarmSince[(size_t) a] < alarmSince[(size_t) b];
+            default:
+                return a < b;
+        }
+    };
+
+    // Ties go by key, so equal rows keep a fixed order without stable_sort's temporary buffer
+    auto compareWithKey = [&compare](int a, int b)
+    {
+        if (compare(a, b))
+            return true;
+
+        return ! compare(b, a) && a < b;
+    };
+
+    if (sortForwards)
+        std::sort(rows.begin(), rows.end(), compareWithKey);
+    else
+        std::sort(rows.begin(), rows.end(), [&compareWithKey](int a, int b) { return compareWithKey(b, a); });
+
+    // Keep the selection on the same channel when rows move
+    if (selectedKey >= 0)
+    {
+        auto selected = std::find(rows.begin(), rows.end(), selectedKey);
+
+        if (selected != rows.end())
+            table.selectRow((int) (selected - rows.begin()), true, true);
+    }
+
+    table.updateContent();
+    table.repaint();
+}
+
+void AlarmPanel::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    sortColumn = newSortColumnId;
+    sortForwards = isForwards;
+    sortRows();
+}
+
+void AlarmPanel::selectedRowsChanged(int lastRowSelected)
+{
+    if (onChannelSelected == nullptr || lastRowSelected < 0 || lastRowSelected >= (int) rows.size())
+        return;
+
+    const int key = rows[(size_t) lastRowSelected];
+
+    if (key == selectedKey)
+        return;
+
+    selectedKey = key;
+    onChannelSelected(isGroup(key) ? -1 : key);
+}
+
+int AlarmPanel::getNumRows()
+{
+    return (int) rows.size();
+}
+
+void AlarmPanel::paintRowBackground(Graphics& g, int rowNumber, int width, int height, bool rowIsSelected)
+{
+    if (rowNumber >= (int) rows.size())
+        return;
+
+    const uint8 flags = shownFlags[(size_t) rows[(size_t) rowNumber]];
+
+    if (flags != 0)
+        g.fillAll(getAlarmColour(flags).withAlpha(0.3f));
+    else if (rowIsSelected)
+        g.fillAll(Colours::darkgrey);
+}
+
+void AlarmPanel::paintCell(Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
+{
+    if (rowNumber >= (int) rows.size())
+        return;
+
+    const int key = rows[(size_t) rowNumber];
+    const uint8 flags = shownFlags[(size_t) key];
+    String text;
+
+    switch (columnId)
+    {
+        case channelColumn:
+            text = isGroup(key) ? settings.groups[(size_t) (key - numChannels)].name : String(key);
+            break;
+        case alarmColumn:
+            text = getAlarmText(flags);
+            break;
+        case rateColumn:
+            text = String(getRowRate(key), 1);
+            break;
+        case sinceColumn:
+            if (flags != 0)
+                text = String((Time::getMillisecondCounter() - alarmSince[(size_t) key]) / 1000) + " s";
+            break;
+        default:
+            break;
+    }
+
+    g.setColour(Colours::white);
+    g.setFont(12.0f);
+    g.drawText(text, 2, 0, width - 4, height, columnId == channelColumn || columnId == alarmColumn
+                                                  ? Justification::centredLeft
+                                                  : Justification::centredRight, true);
+}
+
+Component* AlarmPanel::refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component* existingComponentToUpdate)
+{
+    if (columnId != thresholdColumn || rowNumber >= (int) rows.size())
+    {
+        delete existingComponentToUpdate;
+        return nullptr;
+    }
+
+    auto* label = dynamic_cast<ThresholdLabel*>(existingComponentToUpdate);
+
+    if (label == nullptr)
+    {
+        delete existingComponentToUpdate;
+        label = new ThresholdLabel(*this);
+    }
+
+    label->setRow(rows[(size_t) rowNumber]);
+    return label;
+}
@@ -0,0 +1,126 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ALARMPANEL_H_INCLUDED
+#define ALARMPANEL_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "ChannelAlarmMonitor.h"
+
+#include <functional>
+#include <vector>
+
+/**
+	Sortable table of every channel and alarm group with its alarm state,
+	rate and threshold. Thresholds are edited by double-clicking them.
+
+	Sorted by alarm by default, so alarmed channels are listed first.
+*/
+class AlarmPanel : public Component,
+				   public TableListBoxModel
+{
+public:
+	/** getRate returns the displayed rate of a channel */
+	AlarmPanel(ChannelAlarmMonitor& monitor, std::function<float(int)> getRate);
+
+	/** Rescans the published alarm flags; call when the monitor's state version changes */
+	void alarmsChanged();
+
+	/** Re-sorts and repaints with the current rates */
+	void updateRates();
+
+	/** Outline colour for a set of alarm flags */
+	static Colour getAlarmColour(uint8 flags);
+
+	static String getAlarmText(uint8 flags);
+
+	/** Called with the channel of a clicked row, or -1 for a group row */
+	std::function<void(int)> onChannelSelected;
+
+	void resized() override;
+
+	int getNumRows() override;
+	void paintRowBackground(Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override;
+	void paintCell(Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
+	Component* refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component* existingComponentToUpdate) override;
+	void sortOrderChanged(int newSortColumnId, bool isForwards) override;
+	void selectedRowsChanged(int lastRowSelected) override;
+
+private:
+	enum Columns
+	{
+		channelColumn = 1,
+		alarmColumn,
+		rateColumn,
+		thresholdColumn,
+		sinceColumn
+	};
+
+	/** Edits the threshold of one row */
+	class ThresholdLabel : public Label
+	{
+	public:
+		ThresholdLabel(AlarmPanel& owner);
+
+		void setRow(int key);
+		void textWasEdited() override;
+
+	private:
+		AlarmPanel& owner;
+		int key = 0;
+	};
+
+	/** Rows are channels first, then groups at numChannels + group */
+	bool isGroup(int key) const { return key >= numChannels; }
+	uint8 getRowFlags(int key) const;
+	float getRowRate(int key) const;
+	float getRowThreshold(int key) const;
+	void setRowThreshold(int key, float threshold);
+
+	void updateRows();
+	void sortRows();
+
+	ChannelAlarmMonitor& monitor;
+	std::function<float(int)> getRate;
+
+	TableListBox table;
+
+	int numChannels = 0;
+	int numGroups = 0;
+	/** Copy of the monitor's settings, refreshed only when its settings version changes */
+	ChannelAlarmMonitor::Settings settings;
+	uint32 settingsVersion = 0;
+
+	std::vector<int> rows;
+	std::vector<uint8> shownFlags;
+	std::vector<int64> alarmSince;
+
+	int selectedKey = -1;
+	int sortColumn = alarmColumn;
+	bool sortForwards = false;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AlarmPanel);
+};
+
+#endif // ALARMPANEL_H_INCLUDED
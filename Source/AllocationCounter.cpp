@@ -0,0 +1,151 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AllocationCounter.h"
+
+#if RATEVIEWER_COUNT_ALLOCATIONS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+ #include <malloc.h>
+#endif
+
+namespace
+{
+    std::atomic<std::uint64_t> allocationCount { 0 };
+    std::atomic<std::uint64_t> freeCount { 0 };
+    thread_local int countingDepth = 0;
+
+    void countAllocation()
+    {
+        if (countingDepth > 0)
+            allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Deleting a null pointer does not touch the heap */
+    void release(void* p)
+    {
+        if (p == nullptr)
+            return;
+
+        if (countingDepth > 0)
+            freeCount.fetch_add(1, std::memory_order_relaxed);
+
+        std::free(p);
+    }
+
+    void* allocate(std::size_t size)
+    {
+        countAllocation();
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* allocateAligned(std::size_t size, std::size_t alignment)
+    {
+        countAllocation();
+        size = size == 0 ? 1 : size;
+
+       #if defined(_WIN32)
+        return _aligned_malloc(size, alignment);
+       #else
+        void* p = nullptr;
+        return posix_memalign(&p, std::max(alignment, sizeof(void*)), size) == 0 ? p : nullptr;
+       #endif
+    }
+
+    void releaseAligned(void* p)
+    {
+       #if defined(_WIN32)
+        if (p != nullptr && countingDepth > 0)
+            freeCount.fetch_add(1, std::memory_order_relaxed);
+
+        _aligned_free(p);
+       #else
+        release(p);
+       #endif
+    }
+}
+
+AllocationCounter::ScopedCount::ScopedCount()  { ++countingDepth; }
+AllocationCounter::ScopedCount::~ScopedCount() { --countingDepth; }
+
+std::uint64_t AllocationCounter::getAllocationCount() { return allocationCount.load(); }
+std::uint64_t AllocationCounter::getFreeCount() { return freeCount.load(); }
+
+void AllocationCounter::reset()
+{
+    allocationCount = 0;
+    freeCount = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* p = allocate(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocateAligned(size, (std::size_t) alignment))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, (std::size_t) alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, (std::size_t) alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
+
+#endif
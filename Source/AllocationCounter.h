@@ -0,0 +1,71 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ALLOCATIONCOUNTER_H_INCLUDED
+#define ALLOCATIONCOUNTER_H_INCLUDED
+
+#include <cstdint>
+
+/**
+	Debug check that the acquisition paths do not touch the heap.
+
+	When built with RATEVIEWER_COUNT_ALLOCATIONS=1 this file replaces the
+	global operator new and delete, and every allocation and free made on
+	a thread inside a ScopedCount is counted. In normal builds ScopedCount
+	is empty and the counts are always zero.
+
+	The plugin is then linked with -Bsymbolic-functions on Linux, since a
+	library loaded with RTLD_LOCAL would otherwise bind its own new and
+	delete calls to libstdc++. Tools/AllocationCheck.cpp runs the
+	acquisition-path classes in a standalone executable and fails if any
+	of them allocates or frees.
+
+	Only uses the standard library, so the standalone check can link it.
+*/
+namespace AllocationCounter
+{
+#if RATEVIEWER_COUNT_ALLOCATIONS
+	constexpr bool isEnabled = true;
+
+	/** Counts allocations and frees on this thread while it is alive; may be nested */
+	struct ScopedCount
+	{
+		ScopedCount();
+		~ScopedCount();
+	};
+
+	std::uint64_t getAllocationCount();
+	std::uint64_t getFreeCount();
+	void reset();
+#else
+	constexpr bool isEnabled = false;
+
+	struct ScopedCount {};
+
+	inline std::uint64_t getAllocationCount() { return 0; }
+	inline std::uint64_t getFreeCount() { return 0; }
+	inline void reset() {}
+#endif
+}
+
+#endif // ALLOCATIONCOUNTER_H_INCLUDED
@@ -0,0 +1,84 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "AmplitudeStatistics.h"
+
+float AmplitudeStatistics::getPeakToPeak(const float* samples, int numChannels, int samplesPerChannel)
+{
+    if (samples == nullptr || samplesPerChannel <= 0)
+        return 0.0f;
+
+    float largest = 0.0f;
+
+    // Waveforms are stored channel after channel
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const Range<float> range = FloatVectorOperations::findMinAndMax(samples + (size_t) ch * samplesPerChannel,
+                                                                       samplesPerChannel);
+        largest = jmax(largest, range.getLength());
+    }
+
+    return largest;
+}
+
+void AmplitudeStatistics::setNumChannels(int numChannels_)
+{
+    numChannels = numChannels_;
+
+    mean.assign(numChannels, 0.0f);
+    median.assign(numChannels, 0.0f);
+    count.assign(numChannels, 0);
+}
+
+void AmplitudeStatistics::reset()
+{
+    setNumChannels(numChannels);
+}
+
+void AmplitudeStatistics::addAmplitude(int channel, float amplitude)
+{
+    if (channel < 0 || channel >= numChannels)
+        return;
+
+    if (count[channel] == 0)
+    {
+        mean[channel] = amplitude;
+        median[channel] = amplitude;
+        count[channel] = 1;
+        return;
+    }
+
+    if (count[channel] < std::numeric_limits<uint32>::max())
+        count[channel]++;
+
+    // Plain average at first, then exponentially weighted
+    const float weight = jmax(meanWeight, 1.0f / count[channel]);
+    mean[channel] += weight * (amplitude - mean[channel]);
+
+    const float step = jmax(median[channel] * medianStep, 0.01f);
+
+    if (amplitude > median[channel])
+        median[channel] = jmin(amplitude, median[channel] + step);
+    else if (amplitude < median[channel])
+        median[channel] = jmax(amplitude, median[channel] - step);
+}
@@ -0,0 +1,70 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef AMPLITUDESTATISTICS_H_INCLUDED
+#define AMPLITUDESTATISTICS_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+/**
+	Running peak-to-peak spike amplitude for every channel.
+
+	Keeps two numbers per channel however long the session runs: an
+	exponentially weighted mean and a frugal streaming median, which
+	steps towards each new amplitude by a fraction of its own value.
+*/
+class AmplitudeStatistics
+{
+public:
+	/** Weight of each new amplitude in the mean once enough have been seen */
+	static constexpr float meanWeight = 0.02f;
+
+	/** Median step as a fraction of the current median */
+	static constexpr float medianStep = 0.01f;
+
+	/** Peak-to-peak amplitude of a waveform block; the largest over its channels */
+	static float getPeakToPeak(const float* samples, int numChannels, int samplesPerChannel);
+
+	/** Resizes the per-channel state and clears it */
+	void setNumChannels(int numChannels);
+	int getNumChannels() const { return numChannels; }
+
+	void reset();
+
+	void addAmplitude(int channel, float amplitude);
+
+	/** Negative until the channel has had a spike */
+	float getMean(int channel) const { return count[channel] > 0 ? mean[channel] : -1.0f; }
+	float getMedian(int channel) const { return count[channel] > 0 ? median[channel] : -1.0f; }
+
+private:
+	int numChannels = 0;
+
+	std::vector<float> mean;
+	std::vector<float> median;
+	std::vector<uint32> count;
+};
+
+#endif // AMPLITUDESTATISTICS_H_INCLUDED
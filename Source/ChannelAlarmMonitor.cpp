@@ -0,0 +1,365 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ChannelAlarmMonitor.h"
+#include "ElectrodeGrid.h"
+
+namespace
+{
+    /** Bins closed at once after a stall; older bins would have decayed away anyway */
+    constexpr int64 maxCatchUpBins = 64;
+
+    /** Neighbours per electrode taken from the layout */
+    constexpr int numLayoutNeighbours = 4;
+
+    /** Flips a latched alarm after its condition has held for minBins consecutive bins */
+    bool updateLatched(bool active, bool raise, bool clear, uint16& pending, int minBins)
+    {
+        const bool wantsChange = active ? clear : raise;
+
+        if (! wantsChange)
+        {
+            pending = 0;
+            return active;
+        }
+
+        if (++pending < minBins)
+            return active;
+
+        pending = 0;
+        return ! active;
+    }
+}
+
+ChannelAlarmMonitor::ChannelAlarmMonitor()
+{
+    groupPending.assign(maxGroups, 0);
+    groupFlags.assign(maxGroups, 0);
+    publishedGroupFlags.reset(new std::atomic<uint8>[maxGroups]);
+
+    for (int g = 0; g < maxGroups; ++g)
+        publishedGroupFlags[(size_t) g].store(0);
+}
+
+void ChannelAlarmMonitor::setNumChannels(int numChannels_)
+{
+    if (numChannels_ == numChannels)
+        return;
+
+    numChannels = numChannels_;
+
+    binCounts.assign(numChannels, 0);
+    rates.assign(numChannels, 0.0f);
+    lastSpikeBin.assign(numChannels, currentBin);
+    ratePending.assign(numChannels, 0);
+    runawayPending.assign(numChannels, 0);
+    flags.assign(numChannels, 0);
+    publishedFlags.reset(new std::atomic<uint8>[(size_t) numChannels]);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        publishedFlags[(size_t) ch].store(0);
+
+    stateVersion.fetch_add(1, std::memory_order_release);
+}
+
+void ChannelAlarmMonitor::reset(int64 nowMs)
+{
+    currentBin = nowMs / binMs;
+
+    std::fill(binCounts.begin(), binCounts.end(), 0);
+    std::fill(rates.begin(), rates.end(), 0.0f);
+    std::fill(lastSpikeBin.begin(), lastSpikeBin.end(), currentBin);
+    std::fill(ratePending.begin(), ratePending.end(), 0);
+    std::fill(runawayPending.begin(), runawayPending.end(), 0);
+    std::fill(flags.begin(), flags.end(), 0);
+    std::fill(groupPending.begin(), groupPending.end(), 0);
+    std::fill(groupFlags.begin(), groupFlags.end(), 0);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        publishedFlags[(size_t) ch].store(0, std::memory_order_relaxed);
+
+    for (int g = 0; g < maxGroups; ++g)
+        publishedGroupFlags[(size_t) g].store(0, std::memory_order_relaxed);
+
+    stateVersion.fetch_add(1, std::memory_order_release);
+}
+
+void ChannelAlarmMonitor::setSettings(const Settings& newSettings)
+{
+    settings.publish(newSettings);
+    settingsVersion.fetch_add(1, std::memory_order_release);
+}
+
+ChannelAlarmMonitor::Settings ChannelAlarmMonitor::getSettings() const
+{
+    return settings.getLatest();
+}
+
+void ChannelAlarmMonitor::copySettings(Settings& dest) const
+{
+    settings.copyLatest(dest);
+}
+
+void ChannelAlarmMonitor::setChannelThreshold(int channel, float threshold)
+{
+    if (channel < 0)
+        return;
+
+    Settings updated = getSettings();
+
+    if (channel >= (int) updated.channelThresholds.size())
+        updated.channelThresholds.resize((size_t) channel + 1, 0.0f);
+
+    updated.channelThresholds[(size_t) channel] = jmax(0.0f, threshold);
+    setSettings(updated);
+}
+
+void ChannelAlarmMonitor::setGroupThreshold(int group, float threshold)
+{
+    Settings updated = getSettings();
+
+    if (group < 0 || group >= (int) updated.groups.size())
+        return;
+
+    updated.groups[(size_t) group].threshold = jmax(0.0f, threshold);
+    setSettings(updated);
+}
+
+void ChannelAlarmMonitor::setNeighbours(const std::map<int, std::pair<float, float>>& positions)
+{
+    if (positions.empty())
+    {
+        neighbours.publish(NeighbourTable());
+        return;
+    }
+
+    std::vector<ElectrodeGrid::Item> items;
+    items.reserve(positions.size());
+
+    for (const auto& [id, position] : positions)
+        items.push_back({ position.first, position.second, id });
+
+    ElectrodeGrid grid;
+    grid.build(items);
+
+    NeighbourTable table;
+    const int numIds = positions.rbegin()->first + 1;
+    table.start.assign((size_t) numIds + 1, 0);
+
+    // Neighbours per electrode, then flattened in channel order
+    std::vector<std::vector<int>> found((size_t) numIds);
+
+    for (const auto& [id, position] : positions)
+    {
+        int ids[numLayoutNeighbours + 1];
+        float distancesSquared[numLayoutNeighbours + 1];
+        const int n = grid.findNearest(position.first, position.second, numLayoutNeighbours + 1, ids, distancesSquared);
+
+        for (int k = 0; k < n; ++k)
+            if (ids[k] != id)
+                found[(size_t) id].push_back(ids[k]);
+    }
+
+    for (int id = 0; id < numIds; ++id)
+    {
+        table.start[(size_t) id + 1] = table.start[(size_t) id] + (int) found[(size_t) id].size();
+        table.ids.insert(table.ids.end(), found[(size_t) id].begin(), found[(size_t) id].end());
+    }
+
+    neighbours.publish(std::move(table));
+}
+
+void ChannelAlarmMonitor::addSpike(int channel)
+{
+    if (channel < 0 || channel >= numChannels)
+        return;
+
+    if (binCounts[channel] < std::numeric_limits<uint16>::max())
+        binCounts[channel]++;
+
+    lastSpikeBin[channel] = currentBin;
+}
+
+void ChannelAlarmMonitor::advanceTo(int64 nowMs)
+{
+    const int64 bin = nowMs / binMs;
+
+    if (bin <= currentBin)
+        return;
+
+    // Spikes counted so far belong to the bin being closed first
+    const int64 firstBin = jmax(currentBin, bin - maxCatchUpBins);
+
+    for (int64 b = firstBin; b < bin; ++b)
+    {
+        currentBin = b;
+        closeBin();
+    }
+
+    currentBin = bin;
+}
+
+float ChannelAlarmMonitor::getNeighbourMean(const NeighbourTable& table, int channel) const
+{
+    float sum = 0.0f;
+    int count = 0;
+
+    // An empty table means no layout
+    if (channel + 1 < (int) table.start.size())
+    {
+        for (int i = table.start[(size_t) channel]; i < table.start[(size_t) channel + 1]; ++i)
+        {
+            const int neighbour = table.ids[(size_t) i];
+
+            if (neighbour < numChannels)
+            {
+                sum += rates[neighbour];
+                count++;
+            }
+        }
+    }
+    else
+    {
+        for (int neighbour = channel - 2; neighbour <= channel + 2; ++neighbour)
+        {
+            if (neighbour != channel && neighbour >= 0 && neighbour < numChannels)
+            {
+                sum += rates[neighbour];
+                count++;
+            }
+        }
+    }
+
+    return count > 0 ? sum / count : 0.0f;
+}
+
+void ChannelAlarmMonitor::closeBin()
+{
+    // Both stay pinned until the bin is closed; the writers free old values themselves
+    const PublishedValue<Settings>::Reader current(settings);
+    const PublishedValue<NeighbourTable>::Reader table(neighbours);
+
+    const float alpha = binMs / (float) rateTimeConstantMs;
+    const float binsPerSecond = 1000.0f / binMs;
+    const int minBins = jmax(1, (current->minDurationMs + binMs - 1) / binMs);
+    const float clearFraction = 1.0f - current->hysteresis;
+    const int numThresholds = (int) current->channelThresholds.size();
+
+    // Rates first, so every neighbour mean sees the same bin
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        rates[ch] += alpha * (binCounts[ch] * binsPerSecond - rates[ch]);
+        binCounts[ch] = 0;
+    }
+
+    bool changed = false;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const float rate = rates[ch];
+        uint8 newFlags = flags[ch];
+
+        const float threshold = ch < numThresholds && current->channelThresholds[ch] > 0.0f
+                                    ? current->channelThresholds[ch]
+                                    : current->alarmRate;
+
+        if (threshold > 0.0f)
+        {
+            const bool active = updateLatched(flags[ch] & rateHigh,
+                                              rate > threshold,
+                                              rate < threshold * clearFraction,
+                                              ratePending[ch], minBins);
+            newFlags = active ? (newFlags | rateHigh) : (newFlags & ~rateHigh);
+        }
+        else
+        {
+            newFlags &= ~rateHigh;
+        }
+
+        if (current->silentMs > 0 && (currentBin - lastSpikeBin[ch]) * binMs >= current->silentMs)
+            newFlags |= silent;
+        else
+            newFlags &= ~silent;
+
+        if (current->runawayFactor > 0.0f)
+        {
+            const float reference = current->runawayFactor * jmax(getNeighbourMean(*table, ch), runawayFloorHz);
+            const bool active = updateLatched(flags[ch] & runaway,
+                                              rate > reference,
+                                              rate < reference * clearFraction,
+                                              runawayPending[ch], minBins);
+            newFlags = active ? (newFlags | runaway) : (newFlags & ~runaway);
+        }
+        else
+        {
+            newFlags &= ~runaway;
+        }
+
+        if (newFlags != flags[ch])
+        {
+            flags[ch] = newFlags;
+            publishedFlags[(size_t) ch].store(newFlags, std::memory_order_relaxed);
+            changed = true;
+        }
+    }
+
+    const int numGroups = jmin(maxGroups, (int) current->groups.size());
+
+    for (int g = 0; g < maxGroups; ++g)
+    {
+        uint8 newFlags = 0;
+
+        if (g < numGroups && current->groups[g].threshold > 0.0f)
+        {
+            const Group& group = current->groups[g];
+            float sum = 0.0f;
+            int count = 0;
+
+            for (int ch : group.channels)
+            {
+                if (ch >= 0 && ch < numChannels)
+                {
+                    sum += rates[ch];
+                    count++;
+                }
+            }
+
+            const float mean = count > 0 ? sum / count : 0.0f;
+            const bool active = updateLatched(groupFlags[g] & rateHigh,
+                                              mean > group.threshold,
+                                              mean < group.threshold * clearFraction,
+                                              groupPending[g], minBins);
+            newFlags = active ? rateHigh : 0;
+        }
+
+        if (newFlags != groupFlags[g])
+        {
+            groupFlags[g] = newFlags;
+            publishedGroupFlags[(size_t) g].store(newFlags, std::memory_order_relaxed);
+            changed = true;
+        }
+    }
+
+    if (changed)
+        stateVersion.fetch_add(1, std::memory_order_release);
+}
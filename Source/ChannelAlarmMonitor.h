@@ -0,0 +1,165 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELALARMMONITOR_H_INCLUDED
+#define CHANNELALARMMONITOR_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "PublishedValue.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+	Raises per-channel and per-group alarms from spike counts.
+
+	Runs on the processing thread: spikes are counted into fixed bins and,
+	as each bin closes, every channel's smoothed rate and alarm state are
+	updated in constant time. An alarm is raised once its condition has
+	held for the minimum duration and cleared once the rate has dropped
+	below the threshold by the hysteresis fraction for as long.
+
+	- rateHigh: the rate is above the channel's (or the global) threshold
+	- silent:   no spike for the silent time
+	- runaway:  the rate is far above the mean of the channel's neighbours
+
+	Alarm flags are published as atomics with a version counter, so the
+	message thread only rescans them after something changed.
+*/
+class ChannelAlarmMonitor
+{
+public:
+	enum Flags : uint8
+	{
+		rateHigh = 1,
+		silent = 2,
+		runaway = 4
+	};
+
+	/** A set of channels alarmed on their mean rate */
+	struct Group
+	{
+		String name;
+		std::vector<int> channels;
+		float threshold = 0.0f;
+	};
+
+	struct Settings
+	{
+		float alarmRate = 0.0f;              // Hz, 0 = off
+		float hysteresis = 0.2f;             // fraction below a threshold needed to clear
+		int minDurationMs = 500;
+		int silentMs = 0;                    // 0 = off
+		float runawayFactor = 0.0f;          // times the neighbour mean, 0 = off
+		std::vector<float> channelThresholds; // Hz per channel, 0 = use alarmRate
+		std::vector<Group> groups;
+	};
+
+	static constexpr int binMs = 100;
+	static constexpr int rateTimeConstantMs = 1000;
+	static constexpr int maxGroups = 64;
+
+	/** Neighbour references below this rate are raised to it */
+	static constexpr float runawayFloorHz = 2.0f;
+
+	ChannelAlarmMonitor();
+
+	/** Resizes the per-channel state; not while acquiring */
+	void setNumChannels(int numChannels);
+	int getNumChannels() const { return numChannels; }
+
+	/** Clears all rates and alarms; called when acquisition starts */
+	void reset(int64 nowMs);
+
+	/** Replaces the settings; safe while acquiring */
+	void setSettings(const Settings& settings);
+	Settings getSettings() const;
+
+	/** Copies the settings into dest, reusing its storage; message thread */
+	void copySettings(Settings& dest) const;
+
+	/** Changes whenever the settings are replaced */
+	uint32 getSettingsVersion() const { return settingsVersion.load(std::memory_order_acquire); }
+
+	/** Sets one channel's threshold in Hz (0 = use the global alarm rate) */
+	void setChannelThreshold(int channel, float threshold);
+
+	/** Sets one group's threshold in Hz (0 = off) */
+	void setGroupThreshold(int group, float threshold);
+
+	/** Uses the electrodes nearest to each electrode as its neighbours; safe while acquiring.
+		Without a layout, neighbours are the adjacent channel indices. */
+	void setNeighbours(const std::map<int, std::pair<float, float>>& positions);
+
+	/** Counts a spike (processing thread) */
+	void addSpike(int channel);
+
+	/** Closes every bin that ended before nowMs (processing thread) */
+	void advanceTo(int64 nowMs);
+
+	/** Published alarm flags; any thread */
+	uint8 getFlags(int channel) const { return publishedFlags[(size_t) channel].load(std::memory_order_relaxed); }
+	uint8 getGroupFlags(int group) const { return publishedGroupFlags[(size_t) group].load(std::memory_order_relaxed); }
+
+	/** Changes whenever any published flag changed */
+	uint32 getStateVersion() const { return stateVersion.load(std::memory_order_acquire); }
+
+private:
+	struct NeighbourTable
+	{
+		std::vector<int> start;
+		std::vector<int> ids;
+	};
+
+	void closeBin();
+
+	/** Neighbour mean for one channel, from the table or adjacent indices */
+	float getNeighbourMean(const NeighbourTable& table, int channel) const;
+
+	int numChannels = 0;
+	int64 currentBin = 0;
+
+	std::vector<uint16> binCounts;
+	std::vector<float> rates;
+	std::vector<int64> lastSpikeBin;
+	std::vector<uint16> ratePending;
+	std::vector<uint16> runawayPending;
+	std::vector<uint8> flags;
+	std::unique_ptr<std::atomic<uint8>[]> publishedFlags;
+
+	std::vector<uint16> groupPending;
+	std::vector<uint8> groupFlags;
+	std::unique_ptr<std::atomic<uint8>[]> publishedGroupFlags;
+
+	std::atomic<uint32> stateVersion { 0 };
+	std::atomic<uint32> settingsVersion { 0 };
+
+	/** Written on the message thread, read in closeBin() without locking or freeing */
+	PublishedValue<Settings> settings;
+	PublishedValue<NeighbourTable> neighbours;
+};
+
+#endif // CHANNELALARMMONITOR_H_INCLUDED
@@ -0,0 +1,134 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELBITSET_H_INCLUDED
+#define CHANNELBITSET_H_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/** Portable wrappers for the bit instructions used by the channel bitsets */
+namespace BitOps
+{
+	inline int popcount64(uint64_t word)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		return (int) __popcnt64(word);
+#elif defined(_MSC_VER)
+		word = word - ((word >> 1) & 0x5555555555555555ULL);
+		word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+		word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+		return (int) ((word * 0x0101010101010101ULL) >> 56);
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	/** Index of the lowest set bit; word must not be zero */
+	inline int countTrailingZeros64(uint64_t word)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return (int) index;
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+}
+
+/**
+	One bit per channel.
+
+	Iteration visits only the set bits, so the cost of walking a sparse
+	set (flashing electrodes, members of a group) follows the number of
+	members rather than the number of channels.
+*/
+class ChannelBitset
+{
+public:
+	/** Resizes the set and clears every bit */
+	void resize(int numChannels_)
+	{
+		numChannels = numChannels_;
+		words.assign((size_t) (numChannels + 63) / 64, 0);
+	}
+
+	int size() const { return numChannels; }
+
+	void set(int channel) { words[(size_t) channel >> 6] |= bit(channel); }
+	void reset(int channel) { words[(size_t) channel >> 6] &= ~bit(channel); }
+	bool test(int channel) const { return (words[(size_t) channel >> 6] & bit(channel)) != 0; }
+
+	void clear() { std::fill(words.begin(), words.end(), 0); }
+
+	bool any() const
+	{
+		for (uint64_t word : words)
+			if (word != 0)
+				return true;
+
+		return false;
+	}
+
+	int count() const
+	{
+		int total = 0;
+
+		for (uint64_t word : words)
+			total += BitOps::popcount64(word);
+
+		return total;
+	}
+
+	/** Calls fn(channel) for every set bit, in ascending order */
+	template <typename Fn>
+	void forEach(Fn&& fn) const
+	{
+		for (size_t w = 0; w < words.size(); ++w)
+		{
+			uint64_t word = words[w];
+
+			while (word != 0)
+			{
+				fn((int) (w * 64) + BitOps::countTrailingZeros64(word));
+				word &= word - 1;
+			}
+		}
+	}
+
+	const std::vector<uint64_t>& getWords() const { return words; }
+
+private:
+	static uint64_t bit(int channel) { return uint64_t(1) << (channel & 63); }
+
+	int numChannels = 0;
+	std::vector<uint64_t> words;
+};
+
+#endif // CHANNELBITSET_H_INCLUDED
@@ -0,0 +1,151 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ElectrodeGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void ElectrodeGrid::build(const std::vector<Item>& newItems)
+{
+    items.clear();
+    cellStart.clear();
+    numCellsX = numCellsY = 0;
+
+    if (newItems.empty())
+        return;
+
+    float maxX = newItems[0].x, maxY = newItems[0].y;
+    minX = newItems[0].x;
+    minY = newItems[0].y;
+
+    for (const auto& item : newItems)
+    {
+        minX = std::min(minX, item.x);
+        maxX = std::max(maxX, item.x);
+        minY = std::min(minY, item.y);
+        maxY = std::max(maxY, item.y);
+    }
+
+    // About one electrode per cell, keeping cells roughly square
+    const float width = std::max(maxX - minX, 1e-3f);
+    const float height = std::max(maxY - minY, 1e-3f);
+    const float cellSize = std::sqrt(width * height / newItems.size());
+
+    numCellsX = std::max(1, std::min(1024, (int) std::ceil(width / cellSize)));
+    numCellsY = std::max(1, std::min(1024, (int) std::ceil(height / cellSize)));
+    cellWidth = width / numCellsX;
+    cellHeight = height / numCellsY;
+
+    cellStart.assign((size_t) numCellsX * numCellsY + 1, 0);
+
+    for (const auto& item : newItems)
+        cellStart[(size_t) cellY(item.y) * numCellsX + cellX(item.x) + 1]++;
+
+    for (size_t c = 1; c < cellStart.size(); ++c)
+        cellStart[c] += cellStart[c - 1];
+
+    items.resize(newItems.size());
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+
+    for (const auto& item : newItems)
+        items[(size_t) fill[(size_t) cellY(item.y) * numCellsX + cellX(item.x)]++] = item;
+}
+
+int ElectrodeGrid::cellX(float x) const
+{
+    return std::max(0, std::min(numCellsX - 1, (int) ((x - minX) / cellWidth)));
+}
+
+int ElectrodeGrid::cellY(float y) const
+{
+    return std::max(0, std::min(numCellsY - 1, (int) ((y - minY) / cellHeight)));
+}
+
+int ElectrodeGrid::findNearest(float x, float y, int k, int* ids, float* distancesSquared) const
+{
+    if (items.empty() || k <= 0)
+        return 0;
+
+    k = std::min(k, (int) items.size());
+
+    const int cx = cellX(x);
+    const int cy = cellY(y);
+    const float minCellSize = std::min(cellWidth, cellHeight);
+    const int maxRing = std::max(numCellsX, numCellsY);
+
+    int found = 0;
+
+    for (int ring = 0; ring <= maxRing; ++ring)
+    {
+        const int x0 = cx - ring, x1 = cx + ring;
+        const int y0 = cy - ring, y1 = cy + ring;
+
+        for (int gy = std::max(0, y0); gy <= std::min(numCellsY - 1, y1); ++gy)
+        {
+            const bool edgeRow = gy == y0 || gy == y1;
+            const int step = edgeRow ? 1 : std::max(1, x1 - x0);
+
+            for (int gx = x0; gx <= x1; gx += step)
+            {
+                if (gx < 0 || gx >= numCellsX)
+                    continue;
+
+                const int cell = gy * numCellsX + gx;
+
+                for (int i = cellStart[(size_t) cell]; i < cellStart[(size_t) cell + 1]; ++i)
+                {
+                    const Item& item = items[(size_t) i];
+                    const float dx = item.x - x;
+                    const float dy = item.y - y;
+                    const float d2 = dx * dx + dy * dy;
+
+                    if (found == k && d2 >= distancesSquared[k - 1])
+                        continue;
+
+                    // Insertion into the sorted result list
+                    int pos = found < k ? found++ : k - 1;
+
+                    while (pos > 0 && distancesSquared[pos - 1] > d2)
+                    {
+                        distancesSquared[pos] = distancesSquared[pos - 1];
+                        ids[pos] = ids[pos - 1];
+                        --pos;
+                    }
+
+                    distancesSquared[pos] = d2;
+                    ids[pos] = item.id;
+                }
+            }
+        }
+
+        // Anything in the next ring is at least ring * cell size away
+        const float bound = ring * minCellSize;
+
+        if (found == k && distancesSquared[k - 1] <= bound * bound)
+            break;
+    }
+
+    return found;
+}
@@ -0,0 +1,98 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ELECTRODEGRID_H_INCLUDED
+#define ELECTRODEGRID_H_INCLUDED
+
+#include <vector>
+
+/**
+	Uniform-grid spatial index over electrode positions.
+
+	Electrodes are bucketed into roughly one cell per electrode, stored as
+	a flat cell-start table and an item list. Nearest-neighbour searches
+	walk outward ring by ring and stop once no closer electrode can exist;
+	rectangle queries visit only the cells the rectangle overlaps.
+*/
+class ElectrodeGrid
+{
+public:
+	struct Item
+	{
+		float x;
+		float y;
+		int id;
+	};
+
+	/** Rebuilds the index from a set of positioned electrodes */
+	void build(const std::vector<Item>& items);
+
+	/** Finds up to k electrodes nearest to (x, y), closest first.
+		Writes their ids and squared distances and returns how many were found. */
+	int findNearest(float x, float y, int k, int* ids, float* distancesSquared) const;
+
+	/** Calls fn(id) for every electrode inside the rectangle; only the overlapping cells are visited */
+	template <typename Fn>
+	void forEachInRect(float x0, float y0, float x1, float y1, Fn&& fn) const
+	{
+		if (items.empty() || x1 < x0 || y1 < y0)
+			return;
+
+		const int cx1 = cellX(x1);
+		const int cy1 = cellY(y1);
+
+		for (int gy = cellY(y0); gy <= cy1; ++gy)
+		{
+			for (int gx = cellX(x0); gx <= cx1; ++gx)
+			{
+				const int cell = gy * numCellsX + gx;
+
+				for (int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+				{
+					const Item& item = items[i];
+
+					if (item.x >= x0 && item.x <= x1 && item.y >= y0 && item.y <= y1)
+						fn(item.id);
+				}
+			}
+		}
+	}
+
+	int getNumItems() const { return (int) items.size(); }
+
+private:
+	int cellX(float x) const;
+	int cellY(float y) const;
+
+	std::vector<Item> items;       // sorted by cell
+	std::vector<int> cellStart;    // numCellsX * numCellsY + 1 entries
+
+	float minX = 0.0f;
+	float minY = 0.0f;
+	float cellWidth = 1.0f;
+	float cellHeight = 1.0f;
+	int numCellsX = 0;
+	int numCellsY = 0;
+};
+
+#endif // ELECTRODEGRID_H_INCLUDED
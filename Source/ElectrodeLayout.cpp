@@ -0,0 +1,194 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ElectrodeLayout.h"
+
+#include <yaml-cpp/yaml.h>
+
+namespace
+{
+    const int compiledLayoutMagic = 0x52564c43; // "RVLC"
+    const int compiledLayoutVersion = 1;
+}
+
+String ElectrodeLayout::hashFile(const File& yamlFile)
+{
+    if (! yamlFile.existsAsFile())
+        return String();
+
+    return String::toHexString(yamlFile.loadFileAsString().hashCode64());
+}
+
+std::shared_ptr<ElectrodeLayout> ElectrodeLayout::parseYaml(const File& yamlFile)
+{
+    if (! yamlFile.existsAsFile())
+        return nullptr;
+
+    auto layout = std::make_shared<ElectrodeLayout>();
+    layout->sourceFile = yamlFile.getFullPathName();
+    layout->contentHash = hashFile(yamlFile);
+
+    // This runs on the loader thread, so a malformed file must not throw past here
+    try
+    {
+        const YAML::Node config = YAML::LoadFile(yamlFile.getFullPathName().toStdString());
+
+        int nodeIndex = 0;
+        for (auto node : config["pos"])
+        {
+            // Unconnected sites are listed as nulls and do not take an index
+            if (node[0].IsNull() || node[1].IsNull())
+                continue;
+
+            layout->positions[nodeIndex++] = { node[0].as<float>(), node[1].as<float>() };
+        }
+    }
+    catch (const YAML::Exception&)
+    {
+        return nullptr;
+    }
+
+    return layout;
+}
+
+File ElectrodeLayout::getCacheDirectory()
+{
+    return File::getSpecialLocation(File::userDocumentsDirectory)
+               .getChildFile("Open Ephys")
+               .getChildFile("RateViewer_layouts");
+}
+
+std::shared_ptr<ElectrodeLayout> ElectrodeLayout::loadCompiled(const String& contentHash)
+{
+    if (contentHash.isEmpty())
+        return nullptr;
+
+    FileInputStream input(getCacheDirectory().getChildFile(contentHash + ".bin"));
+
+    if (! input.openedOk()
+        || input.readInt() != compiledLayoutMagic
+        || input.readInt() != compiledLayoutVersion)
+        return nullptr;
+
+    auto layout = std::make_shared<ElectrodeLayout>();
+    layout->contentHash = contentHash;
+    layout->sourceFile = input.readString();
+
+    const int numElectrodes = input.readInt();
+
+    for (int i = 0; i < numElectrodes && ! input.isExhausted(); i++)
+    {
+        const int index = input.readInt();
+        const float x = input.readFloat();
+        const float y = input.readFloat();
+        layout->positions[index] = { x, y };
+    }
+
+    if ((int) layout->positions.size() != numElectrodes)
+        return nullptr;
+
+    return layout;
+}
+
+bool ElectrodeLayout::writeCompiled() const
+{
+    if (contentHash.isEmpty())
+        return false;
+
+    File cacheDir = getCacheDirectory();
+
+    if (! cacheDir.exists())
+        cacheDir.createDirectory();
+
+    File cacheFile = cacheDir.getChildFile(contentHash + ".bin");
+    cacheFile.deleteFile();
+
+    FileOutputStream output(cacheFile);
+
+    if (! output.openedOk())
+        return false;
+
+    output.writeInt(compiledLayoutMagic);
+    output.writeInt(compiledLayoutVersion);
+    output.writeString(sourceFile);
+    output.writeInt((int) positions.size());
+
+    for (const auto& [index, coord] : positions)
+    {
+        output.writeInt(index);
+        output.writeFloat(coord.first);
+        output.writeFloat(coord.second);
+    }
+
+    output.flush();
+    return output.getStatus().wasOk();
+}
+
+
+ElectrodeLayoutLoader::ElectrodeLayoutLoader(const String& sourceFile_,
+                                             const String& contentHash_,
+                                             Callback onLoaded_)
+    : Thread("Rate Viewer Layout Loader"),
+      sourceFile(sourceFile_),
+      contentHash(contentHash_),
+      onLoaded(std::move(onLoaded_))
+{
+}
+
+ElectrodeLayoutLoader::~ElectrodeLayoutLoader()
+{
+    stopThread(2000);
+}
+
+void ElectrodeLayoutLoader::run()
+{
+    auto cached = ElectrodeLayout::loadCompiled(contentHash);
+
+    if (cached != nullptr)
+        deliver(cached);
+
+    if (threadShouldExit())
+        return;
+
+    File yamlFile(sourceFile);
+
+    // The compiled layout is current; nothing left to do
+    if (cached != nullptr && ElectrodeLayout::hashFile(yamlFile) == contentHash)
+        return;
+
+    auto parsed = ElectrodeLayout::parseYaml(yamlFile);
+
+    if (parsed == nullptr || threadShouldExit())
+        return;
+
+    parsed->writeCompiled();
+    deliver(parsed);
+}
+
+void ElectrodeLayoutLoader::deliver(std::shared_ptr<ElectrodeLayout> layout)
+{
+    if (layout->sourceFile.isEmpty())
+        layout->sourceFile = sourceFile;
+
+    MessageManager::callAsync([callback = onLoaded, layout] { callback(layout); });
+}
@@ -0,0 +1,98 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ELECTRODELAYOUT_H_INCLUDED
+#define ELECTRODELAYOUT_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <map>
+#include <memory>
+
+/**
+	Electrode positions read from a YAML layout file.
+
+	Parsed layouts are also written to a small binary "compiled" file,
+	keyed by a hash of the YAML contents, so a saved configuration can
+	restore its layout without running the YAML parser again.
+*/
+struct ElectrodeLayout
+{
+	/** Full path of the YAML file the layout was read from */
+	String sourceFile;
+
+	/** Hash of the YAML file contents at the time it was parsed */
+	String contentHash;
+
+	/** Electrode index -> (x, y) position in layout units */
+	std::map<int, std::pair<float, float>> positions;
+
+	/** Returns the hash used to identify the contents of a layout file */
+	static String hashFile(const File& yamlFile);
+
+	/** Parses a YAML layout file. Returns nullptr if the file cannot be read. */
+	static std::shared_ptr<ElectrodeLayout> parseYaml(const File& yamlFile);
+
+	/** Reads a compiled layout for the given content hash, or nullptr if none is cached */
+	static std::shared_ptr<ElectrodeLayout> loadCompiled(const String& contentHash);
+
+	/** Writes this layout to the compiled layout cache */
+	bool writeCompiled() const;
+
+	/** Directory holding the compiled layouts */
+	static File getCacheDirectory();
+};
+
+/**
+	Restores a saved layout off the message thread.
+
+	The compiled layout matching the saved hash is delivered first; if the
+	YAML file has changed since it was saved, it is parsed again and the
+	fresh layout is delivered afterwards. The callback always runs on the
+	message thread.
+*/
+class ElectrodeLayoutLoader : public Thread
+{
+public:
+	using Callback = std::function<void(std::shared_ptr<ElectrodeLayout>)>;
+
+	/** Constructor */
+	ElectrodeLayoutLoader(const String& sourceFile, const String& contentHash, Callback onLoaded);
+
+	/** Destructor */
+	~ElectrodeLayoutLoader();
+
+	/** Loads the layout */
+	void run() override;
+
+private:
+	void deliver(std::shared_ptr<ElectrodeLayout> layout);
+
+	String sourceFile;
+	String contentHash;
+	Callback onLoaded;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ElectrodeLayoutLoader);
+};
+
+#endif // ELECTRODELAYOUT_H_INCLUDED
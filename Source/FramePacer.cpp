@@ -0,0 +1,72 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "FramePacer.h"
+
+#include <algorithm>
+
+void FramePacer::tick(Activity activity, double costMs)
+{
+    const double frameCostMs = costMs + pendingPaintCostMs;
+    pendingPaintCostMs = 0.0;
+
+    // Paintless ticks are nearly free and would hide the cost of real frames
+    if (activity == Activity::changed || activity == Activity::spiking)
+        averageCostMs = averageCostMs * 0.9 + frameCostMs * 0.1;
+
+    const double tickIntervalMs = 1000.0 / targetHz;
+
+    int wantedHz;
+
+    switch (activity)
+    {
+        case Activity::hidden:
+            unchangedMs = 0.0;
+            wantedHz = settings.backgroundHz;
+            break;
+
+        case Activity::unchanged:
+            unchangedMs += tickIntervalMs;
+            wantedHz = unchangedMs >= settings.idleDelayMs ? settings.idleHz : targetHz;
+            break;
+
+        case Activity::changed:
+            unchangedMs = 0.0;
+            wantedHz = settings.normalHz;
+            break;
+
+        case Activity::spiking:
+        default:
+            unchangedMs = 0.0;
+            wantedHz = settings.maxHz;
+            break;
+    }
+
+    if (averageCostMs > 0.0)
+    {
+        const int affordableHz = (int) (settings.cpuBudget * 1000.0 / averageCostMs);
+        wantedHz = std::min(wantedHz, affordableHz);
+    }
+
+    targetHz = std::max(settings.backgroundHz, std::min(settings.maxHz, wantedHz));
+}
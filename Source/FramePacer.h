@@ -0,0 +1,85 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef FRAMEPACER_H_INCLUDED
+#define FRAMEPACER_H_INCLUDED
+
+/**
+	Chooses the canvas refresh rate from what happened in recent frames.
+
+	Frames with incoming spikes run at the display rate, frames where only
+	decaying rates or flashes changed run at the normal rate, and a canvas
+	that has shown nothing new for a while drops to the idle rate. A hidden
+	canvas only polls at the background rate. Whatever the activity, the
+	rate is capped so the measured frame cost stays within a CPU budget.
+*/
+class FramePacer
+{
+public:
+	/** What a timer tick found */
+	enum class Activity
+	{
+		hidden,     // the canvas is not on screen
+		unchanged,  // nothing visible changed; no repaint
+		changed,    // rates or flashes changed without new spikes
+		spiking     // new spikes arrived since the last tick
+	};
+
+	struct Settings
+	{
+		int backgroundHz = 2;
+		int idleHz = 10;
+		int normalHz = 30;
+		int maxHz = 60;
+
+		/** Time without visible changes before dropping to idleHz */
+		double idleDelayMs = 1000.0;
+
+		/** Fraction of one core the canvas may spend drawing */
+		double cpuBudget = 0.15;
+	};
+
+	FramePacer() = default;
+	explicit FramePacer(const Settings& settings_) : settings(settings_) {}
+
+	/** Records one timer tick and the time it took, in ms */
+	void tick(Activity activity, double costMs);
+
+	/** Adds the cost of a paint call to the current frame's cost */
+	void addPaintCost(double costMs) { pendingPaintCostMs += costMs; }
+
+	/** Refresh rate for the next tick */
+	int getTargetHz() const { return targetHz; }
+
+	const Settings& getSettings() const { return settings; }
+
+private:
+	Settings settings;
+
+	int targetHz = 30;
+	double unchangedMs = 0.0;
+	double averageCostMs = 0.0;
+	double pendingPaintCostMs = 0.0;
+};
+
+#endif // FRAMEPACER_H_INCLUDED
@@ -0,0 +1,147 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "HeatmapRasterizer.h"
+
+void HeatmapRasterizer::setGeometry(Rectangle<int> area_, const ElectrodeGrid& grid,
+                                    const AffineTransform& pixelToGrid, float gridUnitsPerPixel)
+{
+    area = area_;
+    numPixels = area.getWidth() * area.getHeight();
+    maxChannel = -1;
+
+    if (numPixels <= 0 || grid.getNumItems() == 0)
+    {
+        clear();
+        return;
+    }
+
+    for (int k = 0; k < numNeighbours; ++k)
+    {
+        neighbourPlanes[k].resize(numPixels);
+        weightPlanes[k].resize(numPixels);
+    }
+
+    gathered.resize(numPixels);
+    accumulated.resize(numPixels);
+
+    if (image.getWidth() != area.getWidth() || image.getHeight() != area.getHeight())
+        image = Image(Image::ARGB, area.getWidth(), area.getHeight(), true);
+
+    int ids[numNeighbours];
+    float distancesSquared[numNeighbours];
+
+    // Keeps the weight finite on an electrode; about one pixel squared
+    const float offset = gridUnitsPerPixel * gridUnitsPerPixel;
+
+    for (int y = 0; y < area.getHeight(); ++y)
+    {
+        for (int x = 0; x < area.getWidth(); ++x)
+        {
+            const int p = y * area.getWidth() + x;
+            float gridX = area.getX() + x + 0.5f;
+            float gridY = area.getY() + y + 0.5f;
+            pixelToGrid.transformPoint(gridX, gridY);
+
+            const int found = grid.findNearest(gridX, gridY, numNeighbours, ids, distancesSquared);
+
+            // Inverse squared distance
+            float weights[numNeighbours];
+            float total = 0.0f;
+
+            for (int k = 0; k < found; ++k)
+            {
+                weights[k] = 1.0f / (distancesSquared[k] + offset);
+                total += weights[k];
+            }
+
+            // Unused neighbours point at a valid channel with zero weight
+            const int fallback = found > 0 ? ids[0] : 0;
+
+            for (int k = 0; k < numNeighbours; ++k)
+            {
+                const bool used = k < found;
+                neighbourPlanes[k][p] = used ? ids[k] : fallback;
+                weightPlanes[k][p] = used ? weights[k] / total : 0.0f;
+
+                if (used)
+                    maxChannel = jmax(maxChannel, ids[k]);
+            }
+        }
+    }
+}
+
+void HeatmapRasterizer::clear()
+{
+    numPixels = 0;
+    maxChannel = -1;
+    image = Image();
+
+    for (int k = 0; k < numNeighbours; ++k)
+    {
+        std::vector<int>().swap(neighbourPlanes[k]);
+        std::vector<float>().swap(weightPlanes[k]);
+    }
+
+    std::vector<float>().swap(gathered);
+    std::vector<float>().swap(accumulated);
+}
+
+void HeatmapRasterizer::render(const float* rates, int numChannels, float maxRate, const std::array<uint32, 256>& colourLut)
+{
+    // Pixels without neighbours still gather channel 0
+    if (numPixels == 0 || numChannels <= 0 || maxChannel >= numChannels)
+        return;
+
+    float* acc = accumulated.data();
+    float* gatheredRates = gathered.data();
+
+    FloatVectorOperations::clear(acc, numPixels);
+
+    for (int k = 0; k < numNeighbours; ++k)
+    {
+        const int* neighbours = neighbourPlanes[k].data();
+
+        for (int p = 0; p < numPixels; ++p)
+            gatheredRates[p] = rates[neighbours[p]];
+
+        FloatVectorOperations::addWithMultiply(acc, gatheredRates, weightPlanes[k].data(), numPixels);
+    }
+
+    const float lastIndex = (float) (colourLut.size() - 1);
+
+    FloatVectorOperations::multiply(acc, lastIndex / maxRate, numPixels);
+    FloatVectorOperations::clip(acc, acc, 0.0f, lastIndex, numPixels);
+
+    Image::BitmapData pixels(image, Image::BitmapData::writeOnly);
+    const int width = area.getWidth();
+
+    for (int y = 0; y < area.getHeight(); ++y)
+    {
+        uint32* line = reinterpret_cast<uint32*>(pixels.getLinePointer(y));
+        const float* row = acc + y * width;
+
+        for (int x = 0; x < width; ++x)
+            line[x] = colourLut[(size_t) row[x]];
+    }
+}
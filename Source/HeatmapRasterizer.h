@@ -0,0 +1,85 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef HEATMAPRASTERIZER_H_INCLUDED
+#define HEATMAPRASTERIZER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "ElectrodeGrid.h"
+
+#include <array>
+#include <vector>
+
+/**
+	Renders a continuous activity map by inverse-distance interpolation
+	of per-electrode rates.
+
+	Each pixel's nearest electrodes and their weights are found once, when
+	the geometry is set, and stored as one index plane and one weight plane
+	per neighbour. A frame is then a gather of rates per plane, a vectorized
+	multiply-add into an accumulator, a vectorized scale and clip, and a
+	colour lookup written straight into a preallocated image.
+
+	The weights are per screen pixel, so the canvas rebuilds them once the
+	view settles after a zoom or pan, rather than once per layout; in
+	between, the previous map is scaled with the view. This keeps a zoomed
+	map sharp instead of upscaling one built for the whole layout.
+*/
+class HeatmapRasterizer
+{
+public:
+	/** Electrodes contributing to each pixel */
+	static constexpr int numNeighbours = 4;
+
+	/** Precomputes interpolation weights for every pixel of the area.
+		pixelToGrid maps pixel positions into the coordinates of the grid's
+		electrode centres, and gridUnitsPerPixel is one pixel in those units. */
+	void setGeometry(Rectangle<int> area, const ElectrodeGrid& grid,
+					 const AffineTransform& pixelToGrid, float gridUnitsPerPixel);
+
+	/** Releases the weight planes and the image */
+	void clear();
+
+	/** Interpolates the rates over the area and writes the coloured pixels */
+	void render(const float* rates, int numChannels, float maxRate, const std::array<uint32, 256>& colourLut);
+
+	bool isEmpty() const { return numPixels == 0; }
+
+	const Image& getImage() const { return image; }
+	Rectangle<int> getArea() const { return area; }
+
+private:
+	Rectangle<int> area;
+	Image image;
+	int numPixels = 0;
+	int maxChannel = -1;
+
+	/** Full channel ids, so layouts are not limited to 65536 electrodes */
+	std::array<std::vector<int>, numNeighbours> neighbourPlanes;
+	std::array<std::vector<float>, numNeighbours> weightPlanes;
+	std::vector<float> gathered;
+	std::vector<float> accumulated;
+};
+
+#endif // HEATMAPRASTERIZER_H_INCLUDED
@@ -0,0 +1,90 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "IsiHistogramView.h"
+
+IsiHistogramView::IsiHistogramView(const IsiStatistics& statistics_)
+    : statistics(statistics_)
+{
+    setInterceptsMouseClicks(false, false);
+}
+
+void IsiHistogramView::setChannel(int channel_)
+{
+    channel = channel_;
+    setVisible(channel >= 0);
+    repaint();
+}
+
+void IsiHistogramView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black.withAlpha(0.85f));
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds());
+
+    if (channel < 0 || channel >= statistics.getNumChannels())
+        return;
+
+    auto area = getLocalBounds().reduced(6);
+    auto header = area.removeFromTop(16);
+    auto axis = area.removeFromBottom(14);
+
+    const float cv = statistics.getCV(channel);
+
+    g.setColour(Colours::white);
+    g.setFont(12.0f);
+    g.drawText("Channel " + String(channel)
+                   + "   CV " + (cv < 0.0f ? String("-") : String(cv, 2))
+                   + "   Burst " + String(statistics.getBurstiness(channel) * 100.0f, 0) + "%"
+                   + "   Mean " + String(statistics.getMeanIsiMs(channel), 1) + " ms",
+               header, Justification::centredLeft, true);
+
+    const uint32* histogram = statistics.getHistogram(channel);
+    uint32 peak = 1;
+
+    for (int b = 0; b < IsiStatistics::numBins; ++b)
+        peak = jmax(peak, histogram[b]);
+
+    const float barWidth = area.getWidth() / (float) IsiStatistics::numBins;
+
+    g.setColour(Colours::lightgreen);
+
+    for (int b = 0; b < IsiStatistics::numBins; ++b)
+    {
+        const float height = area.getHeight() * histogram[b] / (float) peak;
+        g.fillRect(area.getX() + b * barWidth, area.getBottom() - height, jmax(1.0f, barWidth - 1.0f), height);
+    }
+
+    // Decade ticks on the log axis
+    g.setColour(Colours::grey);
+    g.setFont(10.0f);
+
+    const float decades = std::log10(IsiStatistics::maxIsiMs / IsiStatistics::minIsiMs);
+
+    for (float ms = IsiStatistics::minIsiMs; ms <= IsiStatistics::maxIsiMs; ms *= 10.0f)
+    {
+        const float x = area.getX() + area.getWidth() * std::log10(ms / IsiStatistics::minIsiMs) / decades;
+        const String label = ms < 1000.0f ? String((int) ms) + " ms" : String((int) (ms / 1000.0f)) + " s";
+        g.drawText(label, (int) x - 20, axis.getY(), 40, axis.getHeight(), Justification::centred, false);
+    }
+}
@@ -0,0 +1,96 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "IsiStatistics.h"
+
+#include <cmath>
+
+void IsiStatistics::setNumChannels(int numChannels_)
+{
+    numChannels = numChannels_;
+
+    histograms.assign((size_t) numChannels * numBins, 0);
+    lastSampleNumber.assign(numChannels, -1);
+    meanIsiMs.assign(numChannels, 0.0f);
+    varianceIsiMs.assign(numChannels, 0.0f);
+    burstFraction.assign(numChannels, 0.0f);
+    numIntervals.assign(numChannels, 0);
+}
+
+void IsiStatistics::reset()
+{
+    setNumChannels(numChannels);
+}
+
+float IsiStatistics::getBinEdgeMs(int bin)
+{
+    return minIsiMs * std::pow(maxIsiMs / minIsiMs, bin / (float) numBins);
+}
+
+float IsiStatistics::getCV(int channel) const
+{
+    if (numIntervals[channel] < minIntervals || meanIsiMs[channel] <= 0.0f)
+        return -1.0f;
+
+    return std::sqrt(varianceIsiMs[channel]) / meanIsiMs[channel];
+}
+
+void IsiStatistics::addSpike(int channel, int64 sampleNumber, float sampleRate)
+{
+    if (channel < 0 || channel >= numChannels || sampleRate <= 0.0f)
+        return;
+
+    const int64 previous = lastSampleNumber[channel];
+    lastSampleNumber[channel] = sampleNumber;
+
+    // Sample numbers restart with each acquisition
+    if (previous < 0 || sampleNumber <= previous)
+        return;
+
+    const float isiMs = (float) (sampleNumber - previous) * 1000.0f / sampleRate;
+
+    static const float binsPerLog = numBins / std::log(maxIsiMs / minIsiMs);
+    const int bin = jlimit(0, numBins - 1, (int) (std::log(jmax(isiMs, minIsiMs) / minIsiMs) * binsPerLog));
+
+    uint32* histogram = histograms.data() + (size_t) channel * numBins;
+
+    if (histogram[bin] == std::numeric_limits<uint32>::max())
+        for (int b = 0; b < numBins; ++b)
+            histogram[b] /= 2;
+
+    histogram[bin]++;
+
+    // Plain averages at first, then exponentially weighted
+    if (numIntervals[channel] < std::numeric_limits<uint32>::max())
+        numIntervals[channel]++;
+
+    const uint32 n = numIntervals[channel];
+    const float weight = jmax(statsWeight, 1.0f / n);
+
+    const float delta = isiMs - meanIsiMs[channel];
+    const float increment = weight * delta;
+    meanIsiMs[channel] += increment;
+    varianceIsiMs[channel] = (1.0f - weight) * (varianceIsiMs[channel] + delta * increment);
+
+    burstFraction[channel] += weight * ((isiMs < burstIsiMs ? 1.0f : 0.0f) - burstFraction[channel]);
+}
@@ -0,0 +1,96 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ISISTATISTICS_H_INCLUDED
+#define ISISTATISTICS_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+/**
+	Inter-spike-interval statistics for every channel.
+
+	Each spike's interval to the previous one on its channel is computed
+	from sample numbers and added, in constant time, to:
+
+	- a log-binned histogram with a fixed number of bins
+	- an exponentially weighted mean and variance, giving the CV
+	- an exponentially weighted fraction of intervals shorter than
+	  burstIsiMs, used as the burstiness index
+
+	Memory per channel is fixed; histogram bins are halved together
+	before any of them can overflow.
+*/
+class IsiStatistics
+{
+public:
+	static constexpr int numBins = 40;
+	static constexpr float minIsiMs = 1.0f;
+	static constexpr float maxIsiMs = 10000.0f;
+
+	/** Intervals shorter than this count as bursts */
+	static constexpr float burstIsiMs = 10.0f;
+
+	/** Weight of each new interval once enough have been seen (about the last 100) */
+	static constexpr float statsWeight = 0.01f;
+
+	/** Intervals needed before the CV is reported */
+	static constexpr int minIntervals = 10;
+
+	/** Resizes the per-channel state and clears it */
+	void setNumChannels(int numChannels);
+	int getNumChannels() const { return numChannels; }
+
+	/** Forgets every channel's last spike and statistics; called when acquisition starts */
+	void reset();
+
+	/** Adds a spike at a sample number of a stream with the given sample rate */
+	void addSpike(int channel, int64 sampleNumber, float sampleRate);
+
+	/** numBins counts; bin b covers getBinEdgeMs(b) to getBinEdgeMs(b + 1) */
+	const uint32* getHistogram(int channel) const { return histograms.data() + (size_t) channel * numBins; }
+
+	static float getBinEdgeMs(int bin);
+
+	/** Coefficient of variation of the intervals; negative until minIntervals were seen */
+	float getCV(int channel) const;
+
+	/** Fraction of recent intervals shorter than burstIsiMs */
+	float getBurstiness(int channel) const { return burstFraction[channel]; }
+
+	float getMeanIsiMs(int channel) const { return meanIsiMs[channel]; }
+	uint32 getNumIntervals(int channel) const { return numIntervals[channel]; }
+
+private:
+	int numChannels = 0;
+
+	std::vector<uint32> histograms;
+	std::vector<int64> lastSampleNumber;
+	std::vector<float> meanIsiMs;
+	std::vector<float> varianceIsiMs;
+	std::vector<float> burstFraction;
+	std::vector<uint32> numIntervals;
+};
+
+#endif // ISISTATISTICS_H_INCLUDED
@@ -0,0 +1,283 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PeriStimulusHistogram.h"
+
+float PeriStimulusHistogram::Result::getRate(int channel, int bin) const
+{
+    if (numTriggers == 0)
+        return 0.0f;
+
+    return counts[(size_t) channel * numBins + bin] * 1000.0f / ((float) numTriggers * binMs);
+}
+
+float PeriStimulusHistogram::Result::getResponse(int channel) const
+{
+    if (numTriggers == 0 || channel >= numChannels)
+        return 0.0f;
+
+    const uint32* row = counts.data() + (size_t) channel * numBins;
+    const int preBins = jmin(numBins, preMs / binMs);
+
+    uint64 pre = 0;
+    uint64 post = 0;
+
+    for (int b = 0; b < preBins; ++b)
+        pre += row[b];
+
+    for (int b = preBins; b < numBins; ++b)
+        post += row[b];
+
+    const float baseline = preBins > 0 ? pre * 1000.0f / ((float) numTriggers * preBins * binMs) : 0.0f;
+    const float evoked = numBins > preBins ? post * 1000.0f / ((float) numTriggers * (numBins - preBins) * binMs) : 0.0f;
+
+    return evoked - baseline;
+}
+
+uint64 PeriStimulusHistogram::parseLineMask(const String& text)
+{
+    uint64 mask = 0;
+
+    for (const auto& token : StringArray::fromTokens(text, ",; ", ""))
+    {
+        if (token.isEmpty())
+            continue;
+
+        int first = token.upToFirstOccurrenceOf("-", false, false).getIntValue();
+        int last = token.contains("-") ? token.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+
+        first = jmax(first, 1);
+        last = jmin(last, 64);
+
+        for (int line = first; line <= last; ++line)
+            mask |= (uint64) 1 << (line - 1);
+    }
+
+    return mask;
+}
+
+void PeriStimulusHistogram::setNumChannels(int numChannels_)
+{
+    if (numChannels_ == numChannels && counts != nullptr)
+        return;
+
+    numChannels = numChannels_;
+    setSettings(settings);
+}
+
+void PeriStimulusHistogram::setSettings(const Settings& newSettings)
+{
+    Settings s = newSettings;
+    s.binMs = jmax(1, s.binMs);
+
+    // Whole bins on each side, so one bin edge falls on the trigger
+    const int preBins = jmin(maxBins - 1, jmax(0, s.preMs) / s.binMs);
+    const int postBins = jmin(maxBins - preBins, jmax(1, (s.postMs + s.binMs - 1) / s.binMs));
+
+    s.preMs = preBins * s.binMs;
+    s.postMs = postBins * s.binMs;
+
+    const int bins = preBins + postBins;
+
+    // updateSettings() re-applies the parameters; keep what has been collected
+    if (counts != nullptr && numCounts == (size_t) numChannels * bins
+        && s.preMs == settings.preMs && s.postMs == settings.postMs
+        && s.binMs == settings.binMs && s.lineMask == settings.lineMask)
+        return;
+
+    // Enough spikes to fill the pre-trigger window (plus the disorder slack) at historyRateHz per channel
+    const int64 wantedHistory = (int64) numChannels * historyRateHz * (s.preMs + maxDisorderMs) / 1000;
+    const int newHistorySize = (int) jlimit((int64) minHistorySize, (int64) (1 << 24), wantedHistory);
+
+    // Allocate outside the lock; the processing thread only waits for the swap
+    const size_t newNumCounts = (size_t) numChannels * bins;
+    std::unique_ptr<std::atomic<uint32>[]> newCounts(new std::atomic<uint32>[newNumCounts]);
+
+    for (size_t i = 0; i < newNumCounts; ++i)
+        newCounts[i].store(0, std::memory_order_relaxed);
+
+    std::vector<SpikeTime> newHistory(newHistorySize != historySize ? (size_t) newHistorySize : 0);
+
+    {
+        const SpinLock::ScopedLockType scopedLock(lock);
+
+        settings = s;
+        numBins = bins;
+        numCounts = newNumCounts;
+        counts.swap(newCounts);
+
+        if (! newHistory.empty())
+        {
+            history.swap(newHistory);
+            historySize = newHistorySize;
+            historyHead = 0;
+        }
+
+        numTriggers = 0;
+        numTruncated = 0;
+        historyCount = 0;
+        openCount = 0;
+    }
+
+    activeLines = s.lineMask;
+    version++;
+}
+
+void PeriStimulusHistogram::reset()
+{
+    {
+        const SpinLock::ScopedLockType scopedLock(lock);
+
+        clearCounts();
+        historyCount = 0;
+        openCount = 0;
+    }
+
+    version++;
+}
+
+void PeriStimulusHistogram::clearCounts()
+{
+    for (size_t i = 0; i < numCounts; ++i)
+        counts[i].store(0, std::memory_order_relaxed);
+
+    numTriggers = 0;
+    numTruncated = 0;
+}
+
+void PeriStimulusHistogram::addToBin(int channel, double offsetMs)
+{
+    const int bin = (int) ((offsetMs + settings.preMs) / settings.binMs);
+
+    if (bin >= 0 && bin < numBins)
+    {
+        auto& count = counts[(size_t) channel * numBins + bin];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void PeriStimulusHistogram::addTrigger(int line, double timeMs)
+{
+    if (line < 0 || line >= 64 || (activeLines.load(std::memory_order_relaxed) & ((uint64) 1 << line)) == 0)
+        return;
+
+    {
+        const SpinLock::ScopedLockType scopedLock(lock);
+
+        if (numBins == 0)
+            return;
+
+        // Spikes already seen that fall inside this trigger's window, newest first
+        int replayed = 0;
+
+        for (; replayed < historyCount; ++replayed)
+        {
+            const SpikeTime& spike = history[(historyHead - 1 - replayed + historySize) % historySize];
+            const double offset = spike.timeMs - timeMs;
+
+            // Streams are only roughly in time order, so stop a little past the window
+            if (offset < -settings.preMs - maxDisorderMs)
+                break;
+
+            addToBin(spike.channel, offset);
+        }
+
+        // A full ring that ran out before the window's start has cut the baseline short
+        if (replayed == historySize && settings.preMs > 0)
+        {
+            const SpikeTime& oldest = history[(size_t) historyHead];
+
+            if (oldest.timeMs - timeMs > -settings.preMs)
+                numTruncated.store(numTruncated.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // Too many overlapping triggers: the oldest stops counting
+        if (openCount == maxOpenTriggers)
+        {
+            openHead = (openHead + 1) % maxOpenTriggers;
+            openCount--;
+        }
+
+        openTriggers[(openHead + openCount) % maxOpenTriggers] = timeMs;
+        openCount++;
+        numTriggers.store(numTriggers.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    version++;
+}
+
+void PeriStimulusHistogram::addSpike(int channel, double timeMs)
+{
+    if (activeLines.load(std::memory_order_relaxed) == 0)
+        return;
+
+    {
+        const SpinLock::ScopedLockType scopedLock(lock);
+
+        if (channel < 0 || channel >= numChannels || history.empty())
+            return;
+
+        history[historyHead] = { channel, timeMs };
+        historyHead = (historyHead + 1) % historySize;
+        historyCount = jmin(historyCount + 1, historySize);
+
+        // Triggers open in time order, so closed ones are always at the head
+        while (openCount > 0 && timeMs - openTriggers[openHead] >= settings.postMs)
+        {
+            openHead = (openHead + 1) % maxOpenTriggers;
+            openCount--;
+        }
+
+        if (openCount == 0)
+            return;
+
+        for (int i = 0; i < openCount; ++i)
+            addToBin(channel, timeMs - openTriggers[(openHead + i) % maxOpenTriggers]);
+    }
+
+    version++;
+}
+
+bool PeriStimulusHistogram::getResult(uint32& lastVersion, Result& result) const
+{
+    const uint32 current = version.load();
+
+    if (current == lastVersion)
+        return false;
+
+    // The shape only changes on this thread, so the counts can be copied without the lock.
+    // A spike landing mid-copy only makes the copy a little newer in some bins.
+    lastVersion = current;
+    result.numTriggers = numTriggers.load(std::memory_order_relaxed);
+    result.numTruncated = numTruncated.load(std::memory_order_relaxed);
+    result.counts.resize(numCounts);
+
+    for (size_t i = 0; i < numCounts; ++i)
+        result.counts[i] = counts[i].load(std::memory_order_relaxed);
+
+    result.numChannels = numChannels;
+    result.numBins = numBins;
+    result.binMs = settings.binMs;
+    result.preMs = settings.preMs;
+    return true;
+}
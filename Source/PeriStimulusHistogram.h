@@ -0,0 +1,160 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PERISTIMULUSHISTOGRAM_H_INCLUDED
+#define PERISTIMULUSHISTOGRAM_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+	Peri-stimulus spike histograms for every channel, triggered by TTL onsets.
+
+	Every count lives in one preallocated array, so accumulating never
+	allocates however many triggers arrive. When a trigger arrives on a
+	selected line, the recent-spike ring is replayed into the pre-trigger
+	bins. Later spikes are added to each trigger that is still open. A
+	trigger closes once a spike passes the end of its post window. If more
+	than maxOpenTriggers overlap, the oldest one closes early.
+
+	Times are synchronised milliseconds, so TTL and spike streams with
+	different sample rates and start times line up.
+
+	Counts are written only by the processing thread and read without the
+	lock, so copying a result never holds it up; the lock only guards
+	against the message thread resizing or clearing the histograms.
+*/
+class PeriStimulusHistogram
+{
+public:
+	static constexpr int maxBins = 1000;
+	static constexpr int maxOpenTriggers = 64;
+
+	/** The recent-spike ring covers the pre-trigger window at this rate on every channel */
+	static constexpr int historyRateHz = 50;
+	static constexpr int minHistorySize = 16384;
+
+	/** How far out of time order spikes from different streams may arrive */
+	static constexpr int maxDisorderMs = 1000;
+
+	struct Settings
+	{
+		int preMs = 100;
+		int postMs = 500;
+		int binMs = 10;
+
+		/** Bit n selects TTL line n */
+		uint64 lineMask = 1;
+	};
+
+	/** Copy of the histograms handed to the message thread */
+	struct Result
+	{
+		std::vector<uint32> counts;   // numBins per channel
+		int numChannels = 0;
+		int numBins = 0;
+		int binMs = 1;
+		int preMs = 0;
+		int numTriggers = 0;
+
+		/** Triggers whose pre-trigger window outran the spike history, so their baseline is low */
+		int numTruncated = 0;
+
+		/** Mean rate in Hz over all triggers */
+		float getRate(int channel, int bin) const;
+
+		/** Mean post-trigger rate minus the pre-trigger baseline, in Hz; 0 without triggers */
+		float getResponse(int channel) const;
+	};
+
+	/** Parses a list such as "1, 3-5" of 1-based TTL lines */
+	static uint64 parseLineMask(const String& text);
+
+	void setNumChannels(int numChannels);
+
+	/** Resizes the histograms and spike history if needed and clears them (message thread).
+		Does nothing if neither the settings nor the channel count changed. */
+	void setSettings(const Settings& settings);
+	Settings getSettings() const { return settings; }
+
+	/** Clears the histograms and spike history; called when acquisition starts (message thread) */
+	void reset();
+
+	/** True if any line is selected; spikes and triggers are ignored otherwise */
+	bool isActive() const { return activeLines.load(std::memory_order_relaxed) != 0; }
+
+	/** Starts a trigger if the line is selected (processing thread) */
+	void addTrigger(int line, double timeMs);
+
+	/** Adds a spike to the open triggers and the history (processing thread) */
+	void addSpike(int channel, double timeMs);
+
+	/** Copies the histograms if they changed since lastVersion, and updates lastVersion (message thread) */
+	bool getResult(uint32& lastVersion, Result& result) const;
+
+private:
+	struct SpikeTime
+	{
+		int channel;
+		double timeMs;
+	};
+
+	/** Adds one spike to one trigger's bins; caller holds the lock */
+	void addToBin(int channel, double offsetMs);
+
+	/** Zeroes every count and the trigger totals; caller holds the lock */
+	void clearCounts();
+
+	Settings settings;
+	std::atomic<uint64> activeLines { 1 };
+
+	SpinLock lock;
+
+	// The shape only changes on the message thread
+	int numChannels = 0;
+	int numBins = 0;
+	size_t numCounts = 0;
+
+	// Single writer, so increments are a relaxed load and store
+	std::unique_ptr<std::atomic<uint32>[]> counts;
+	std::atomic<int> numTriggers { 0 };
+	std::atomic<int> numTruncated { 0 };
+
+	std::vector<SpikeTime> history;
+	int historySize = 0;
+	int historyHead = 0;
+	int historyCount = 0;
+
+	double openTriggers[maxOpenTriggers];
+	int openHead = 0;
+	int openCount = 0;
+
+	std::atomic<uint32> version { 1 };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeriStimulusHistogram);
+};
+
+#endif // PERISTIMULUSHISTOGRAM_H_INCLUDED
@@ -0,0 +1,100 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PsthView.h"
+
+PsthView::PsthView(const PeriStimulusHistogram::Result& result_)
+    : result(result_)
+{
+    setInterceptsMouseClicks(false, false);
+}
+
+void PsthView::setChannel(int channel_)
+{
+    channel = channel_;
+    setVisible(channel >= 0);
+    repaint();
+}
+
+void PsthView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black.withAlpha(0.85f));
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds());
+
+    if (channel < 0 || channel >= result.numChannels || result.numBins == 0)
+        return;
+
+    auto area = getLocalBounds().reduced(6);
+    auto header = area.removeFromTop(16);
+    auto axis = area.removeFromBottom(14);
+
+    const float response = result.getResponse(channel);
+
+    g.setColour(Colours::white);
+    g.setFont(12.0f);
+    g.drawText("Channel " + String(channel)
+                   + "   Triggers " + String(result.numTriggers)
+                   + "   Response " + (response >= 0.0f ? "+" : "") + String(response, 1) + " Hz",
+               header, Justification::centredLeft, true);
+
+    // The spike history could not reach back over the whole pre-trigger window
+    if (result.numTruncated > 0)
+    {
+        g.setColour(Colours::orange);
+        g.drawText("Baseline short on " + String(result.numTruncated) + " triggers",
+                   header, Justification::centredRight, true);
+    }
+
+    float peak = 1.0f;
+
+    for (int b = 0; b < result.numBins; ++b)
+        peak = jmax(peak, result.getRate(channel, b));
+
+    const float barWidth = area.getWidth() / (float) result.numBins;
+    const int preBins = result.preMs / result.binMs;
+
+    for (int b = 0; b < result.numBins; ++b)
+    {
+        const float height = area.getHeight() * result.getRate(channel, b) / peak;
+
+        g.setColour(b < preBins ? Colours::grey : Colours::orange);
+        g.fillRect(area.getX() + b * barWidth, area.getBottom() - height, jmax(1.0f, barWidth - 1.0f), height);
+    }
+
+    // Trigger line and window edges
+    const float triggerX = area.getX() + preBins * barWidth;
+
+    g.setColour(Colours::white);
+    g.drawVerticalLine((int) triggerX, (float) area.getY(), (float) area.getBottom());
+
+    g.setColour(Colours::grey);
+    g.setFont(10.0f);
+
+    const int postMs = (result.numBins - preBins) * result.binMs;
+
+    g.drawText("-" + String(result.preMs) + " ms", area.getX(), axis.getY(), 60, axis.getHeight(), Justification::centredLeft, false);
+    g.drawText("0", (int) triggerX - 20, axis.getY(), 40, axis.getHeight(), Justification::centred, false);
+    g.drawText("+" + String(postMs) + " ms", area.getRight() - 60, axis.getY(), 60, axis.getHeight(), Justification::centredRight, false);
+    g.drawText(String(peak, 0) + " Hz", area.getRight() - 60, area.getY(), 60, 12, Justification::centredRight, false);
+}
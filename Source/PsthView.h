@@ -0,0 +1,53 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PSTHVIEW_H_INCLUDED
+#define PSTHVIEW_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "PeriStimulusHistogram.h"
+
+/**
+	Draws the selected channel's peri-stimulus histogram, with the trigger
+	marked and the evoked response in the header.
+*/
+class PsthView : public Component
+{
+public:
+	PsthView(const PeriStimulusHistogram::Result& result);
+
+	/** Shows a channel's histogram; -1 shows nothing */
+	void setChannel(int channel);
+	int getChannel() const { return channel; }
+
+	void paint(Graphics& g) override;
+
+private:
+	const PeriStimulusHistogram::Result& result;
+	int channel = -1;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PsthView);
+};
+
+#endif // PSTHVIEW_H_INCLUDED
@@ -0,0 +1,123 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef PUBLISHEDVALUE_H_INCLUDED
+#define PUBLISHEDVALUE_H_INCLUDED
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/**
+	A value written on one side and read on the processing thread without
+	locks, allocation or frees.
+
+	Two slots are preallocated. publish() fills the slot the reader is not
+	using and then flips the index, so old values are overwritten and freed
+	by the writer. The reader pins a slot for the length of a Reader, and a
+	writer that needs the pinned slot yields until it is released; readers
+	never wait.
+
+	Only one thread may read at a time. Writers are serialised.
+*/
+template <typename T>
+class PublishedValue
+{
+public:
+	PublishedValue() = default;
+	explicit PublishedValue(const T& initial) { slots[0] = slots[1] = initial; }
+
+	/** Replaces the value (writer side) */
+	void publish(T value)
+	{
+		const std::lock_guard<std::mutex> lock(writeLock);
+
+		const int next = 1 - index.load(std::memory_order_relaxed);
+
+		// A reader may still hold the older slot from before the last flip
+		while (readerSlot.load(std::memory_order_seq_cst) == next)
+			std::this_thread::yield();
+
+		slots[next] = std::move(value);
+		index.store(next, std::memory_order_seq_cst);
+	}
+
+	/** Copy of the newest value (writer side) */
+	T getLatest() const
+	{
+		const std::lock_guard<std::mutex> lock(writeLock);
+		return slots[index.load(std::memory_order_relaxed)];
+	}
+
+	/** Assigns the newest value to dest, reusing its storage (writer side) */
+	void copyLatest(T& dest) const
+	{
+		const std::lock_guard<std::mutex> lock(writeLock);
+		dest = slots[index.load(std::memory_order_relaxed)];
+	}
+
+	/** Pins the newest value while in scope (reader side) */
+	class Reader
+	{
+	public:
+		explicit Reader(PublishedValue& owner_) : owner(owner_)
+		{
+			for (;;)
+			{
+				const int slot = owner.index.load(std::memory_order_seq_cst);
+				owner.readerSlot.store(slot, std::memory_order_seq_cst);
+
+				// Only a slot that is still current after pinning is safe from the writer
+				if (owner.index.load(std::memory_order_seq_cst) == slot)
+				{
+					value = &owner.slots[slot];
+					return;
+				}
+			}
+		}
+
+		~Reader() { owner.readerSlot.store(-1, std::memory_order_release); }
+
+		const T& operator*() const { return *value; }
+		const T* operator->() const { return value; }
+
+	private:
+		PublishedValue& owner;
+		const T* value = nullptr;
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+	};
+
+private:
+	T slots[2];
+	std::atomic<int> index { 0 };
+	std::atomic<int> readerSlot { -1 };
+	mutable std::mutex writeLock;
+
+	PublishedValue(const PublishedValue&) = delete;
+	PublishedValue& operator=(const PublishedValue&) = delete;
+};
+
+#endif // PUBLISHEDVALUE_H_INCLUDED
@@ -0,0 +1,298 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RATEKERNELS_H_INCLUDED
+#define RATEKERNELS_H_INCLUDED
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+	Rate estimators built from kernel policies.
+
+	Spikes are counted into fixed-width time bins, and the rate of a channel
+	is the weighted sum of its bins over the window. The weight of a bin
+	decays exponentially with its age (time constant = window length), and
+	the weights are normalised so that a steady rate reads back unchanged:
+	the sum of weight times bin width, in seconds, is one.
+
+	Kernels for the common window settings are specialized at compile time:
+	their weight tables are constexpr and their bin counts are constants, so
+	the per-channel loop is a fixed-length multiply-add with no calls to exp()
+	and no branches. Any other window uses the runtime kernel.
+*/
+namespace RateKernels
+{
+	/** Number of bins every kernel splits its window into */
+	constexpr int binsPerWindow = 100;
+
+	/** exp() usable in constant expressions: halves the argument, sums a Taylor series, then squares back up */
+	constexpr double constexprExp(double x)
+	{
+		int halvings = 0;
+
+		while (x > 0.5 || x < -0.5)
+		{
+			x *= 0.5;
+			++halvings;
+		}
+
+		double term = 1.0;
+		double sum = 1.0;
+
+		for (int n = 1; n < 16; ++n)
+		{
+			term *= x / n;
+			sum += term;
+		}
+
+		while (halvings-- > 0)
+			sum *= sum;
+
+		return sum;
+	}
+
+	/** Unnormalised decay of a bin that is 'age' bins old */
+	constexpr double binDecay(int age, int binMs, int windowMs)
+	{
+		return constexprExp(-(age + 0.5) * binMs / (double) windowMs);
+	}
+
+	/** Sum of the decays over a window of numBins bins, which the weights are divided by */
+	constexpr double decaySum(int numBins, int binMs, int windowMs)
+	{
+		double sum = 0.0;
+
+		for (int age = 0; age < numBins; ++age)
+			sum += binDecay(age, binMs, windowMs);
+
+		return sum;
+	}
+
+	/** Weight of a bin that is 'age' bins old, given the window's decay sum */
+	constexpr float binWeight(int age, int binMs, int windowMs, double windowDecaySum)
+	{
+		return (float) (binDecay(age, binMs, windowMs) / (windowDecaySum * binMs / 1000.0));
+	}
+
+	/**
+		Weight table laid out so that, with the bin ring's write position at 'head',
+		the weights for slots 0..numBins-1 start at table[numBins - 1 - head].
+		This keeps the per-channel loop contiguous without a modulo.
+	*/
+	template <int NumBins>
+	constexpr std::array<float, 2 * NumBins> makeDecayTable(int binMs, int windowMs)
+	{
+		std::array<float, 2 * NumBins> table {};
+		const double windowDecaySum = decaySum(NumBins, binMs, windowMs);
+
+		for (int m = 0; m < 2 * NumBins; ++m)
+		{
+			const int age = m < NumBins ? NumBins - 1 - m : 2 * NumBins - 1 - m;
+			table[m] = binWeight(age, binMs, windowMs, windowDecaySum);
+		}
+
+		return table;
+	}
+
+	/** Kernel with its window and bin width fixed at compile time */
+	template <int WindowMs, int BinMs>
+	struct FixedExponentialKernel
+	{
+		static_assert(WindowMs % BinMs == 0, "Window must be a whole number of bins");
+
+		static constexpr int numBins = WindowMs / BinMs;
+		static constexpr std::array<float, 2 * numBins> table = makeDecayTable<numBins>(BinMs, WindowMs);
+
+		static constexpr int getNumBins() { return numBins; }
+		static constexpr int getBinMs() { return BinMs; }
+		static constexpr int getWindowMs() { return WindowMs; }
+		const float* getTable() const { return table.data(); }
+	};
+
+	/** Kernel for window settings without a specialization */
+	struct RuntimeExponentialKernel
+	{
+		explicit RuntimeExponentialKernel(int windowMs_)
+			: windowMs(windowMs_),
+			  binMs(std::max(1, windowMs_ / binsPerWindow)),
+			  numBins(std::max(1, windowMs_ / binMs)),
+			  table(2 * numBins)
+		{
+			double decaySum = 0.0;
+
+			for (int age = 0; age < numBins; ++age)
+				decaySum += std::exp(-(age + 0.5) * binMs / windowMs);
+
+			for (int m = 0; m < 2 * numBins; ++m)
+			{
+				const int age = m < numBins ? numBins - 1 - m : 2 * numBins - 1 - m;
+				table[m] = (float) (std::exp(-(age + 0.5) * binMs / windowMs) / (decaySum * binMs / 1000.0));
+			}
+		}
+
+		int getNumBins() const { return numBins; }
+		int getBinMs() const { return binMs; }
+		int getWindowMs() const { return windowMs; }
+		const float* getTable() const { return table.data(); }
+
+		int windowMs;
+		int binMs;
+		int numBins;
+		std::vector<float> table;
+	};
+
+	/** Per-channel binned spike counts and the rates derived from them */
+	class RateEstimator
+	{
+	public:
+		virtual ~RateEstimator() = default;
+
+		/** Resizes the count storage and clears all bins */
+		virtual void setNumChannels(int numChannels) = 0;
+
+		virtual int getNumChannels() const = 0;
+		virtual int getWindowMs() const = 0;
+		virtual int getBinMs() const = 0;
+		virtual int getNumBins() const = 0;
+
+		/** Adds spikes to a channel's current bin */
+		virtual void addSpikes(int channel, float count) = 0;
+
+		/** Moves the current bin forward, clearing bins that leave the window */
+		virtual void advanceBins(int numBins) = 0;
+
+		/** Writes rates in Hz for channels [begin, end) */
+		virtual void computeRates(float* rates, int begin, int end) const = 0;
+
+		/** Advances the bins to a millisecond timestamp */
+		void advanceTo(int64_t timeMs)
+		{
+			if (currentBinStart < 0)
+				currentBinStart = timeMs;
+
+			const int64_t elapsedBins = (timeMs - currentBinStart) / getBinMs();
+
+			if (elapsedBins <= 0)
+				return;
+
+			advanceBins((int) std::min<int64_t>(elapsedBins, getNumBins()));
+			currentBinStart += elapsedBins * getBinMs();
+		}
+
+	protected:
+		int64_t currentBinStart = -1;
+	};
+
+	/** Estimator specialized on a kernel policy */
+	template <class Kernel>
+	class KernelRateEstimator : public RateEstimator
+	{
+	public:
+		explicit KernelRateEstimator(Kernel kernel_ = Kernel())
+			: kernel(std::move(kernel_))
+		{
+		}
+
+		void setNumChannels(int numChannels_) override
+		{
+			numChannels = numChannels_;
+			counts.assign((size_t) numChannels * kernel.getNumBins(), 0.0f);
+			head = 0;
+		}
+
+		int getNumChannels() const override { return numChannels; }
+		int getWindowMs() const override { return kernel.getWindowMs(); }
+		int getBinMs() const override { return kernel.getBinMs(); }
+		int getNumBins() const override { return kernel.getNumBins(); }
+
+		void addSpikes(int channel, float count) override
+		{
+			if (channel >= 0 && channel < numChannels)
+				counts[(size_t) channel * kernel.getNumBins() + head] += count;
+		}
+
+		void advanceBins(int numBinsToAdvance) override
+		{
+			const int numBins = kernel.getNumBins();
+
+			if (numBinsToAdvance >= numBins)
+			{
+				std::fill(counts.begin(), counts.end(), 0.0f);
+				head = (head + numBinsToAdvance) % numBins;
+				return;
+			}
+
+			for (int i = 0; i < numBinsToAdvance; ++i)
+			{
+				head = (head + 1) % numBins;
+
+				for (int ch = 0; ch < numChannels; ++ch)
+					counts[(size_t) ch * numBins + head] = 0.0f;
+			}
+		}
+
+		void computeRates(float* rates, int begin, int end) const override
+		{
+			const int numBins = kernel.getNumBins();
+			const float* weights = kernel.getTable() + (numBins - 1 - head);
+
+			for (int ch = begin; ch < end; ++ch)
+			{
+				const float* binCounts = counts.data() + (size_t) ch * numBins;
+				float rate = 0.0f;
+
+				for (int b = 0; b < numBins; ++b)
+					rate += binCounts[b] * weights[b];
+
+				rates[ch] = rate;
+			}
+		}
+
+	private:
+		Kernel kernel;
+		int numChannels = 0;
+		int head = 0;
+		std::vector<float> counts;
+	};
+
+	/** Returns the specialized estimator for a window setting, or the runtime one if there is none */
+	inline std::unique_ptr<RateEstimator> createRateEstimator(int windowMs)
+	{
+		switch (windowMs)
+		{
+			case 250:  return std::make_unique<KernelRateEstimator<FixedExponentialKernel<250, 250 / binsPerWindow>>>();
+			case 500:  return std::make_unique<KernelRateEstimator<FixedExponentialKernel<500, 500 / binsPerWindow>>>();
+			case 1000: return std::make_unique<KernelRateEstimator<FixedExponentialKernel<1000, 1000 / binsPerWindow>>>();
+			case 2000: return std::make_unique<KernelRateEstimator<FixedExponentialKernel<2000, 2000 / binsPerWindow>>>();
+			case 5000: return std::make_unique<KernelRateEstimator<FixedExponentialKernel<5000, 5000 / binsPerWindow>>>();
+			default:   return std::make_unique<KernelRateEstimator<RuntimeExponentialKernel>>(RuntimeExponentialKernel(windowMs));
+		}
+	}
+}
+
+#endif // RATEKERNELS_H_INCLUDED
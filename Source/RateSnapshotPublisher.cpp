@@ -0,0 +1,148 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RateSnapshotPublisher.h"
+#include "RateSnapshotShm.h"
+
+#include <atomic>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+ #define RATEVIEWER_HAS_POSIX_SHM 1
+#else
+ #define RATEVIEWER_HAS_POSIX_SHM 0
+#endif
+
+static_assert(sizeof(rv_shm_header) == 64, "the shared header must stay 64 bytes");
+static_assert(sizeof(rv_shm_slot) % 8 == 0, "rates must stay aligned after the slot header");
+
+RateSnapshotPublisher::~RateSnapshotPublisher()
+{
+    close();
+}
+
+bool RateSnapshotPublisher::open(const String& name_, int maxChannels_)
+{
+    close();
+
+#if RATEVIEWER_HAS_POSIX_SHM
+    if (maxChannels_ <= 0)
+        return false;
+
+    const size_t slotSize = (sizeof(rv_shm_slot) + (size_t) maxChannels_ * sizeof(float) + 63) & ~(size_t) 63;
+    const size_t size = sizeof(rv_shm_header) + RV_SHM_NUM_SLOTS * slotSize;
+
+    // A stale object from an earlier session may have another size
+    shm_unlink(name_.toRawUTF8());
+
+    const int fd = shm_open(name_.toRawUTF8(), O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, (off_t) size) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name_.toRawUTF8());
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        shm_unlink(name_.toRawUTF8());
+        return false;
+    }
+
+    name = name_;
+    base = mapped;
+    mappedSize = size;
+    maxChannels = maxChannels_;
+    sequence = 0;
+
+    // ftruncate zero-fills, so every lock starts even and no snapshot is published
+    auto* header = static_cast<rv_shm_header*>(base);
+    header->num_slots = RV_SHM_NUM_SLOTS;
+    header->max_channels = (uint32_t) maxChannels;
+    header->slot_size = slotSize;
+    header->version = RV_SHM_VERSION;
+
+    // Readers check the magic first, so it is written last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = RV_SHM_MAGIC;
+
+    return true;
+#else
+    ignoreUnused(name_, maxChannels_);
+    return false;
+#endif
+}
+
+void RateSnapshotPublisher::close()
+{
+#if RATEVIEWER_HAS_POSIX_SHM
+    if (base == nullptr)
+        return;
+
+    munmap(base, mappedSize);
+    shm_unlink(name.toRawUTF8());
+#endif
+
+    base = nullptr;
+    mappedSize = 0;
+    maxChannels = 0;
+}
+
+void RateSnapshotPublisher::publish(const float* rates, int numChannels, int64 sampleNumber, double sampleRate)
+{
+    if (base == nullptr)
+        return;
+
+    auto* header = static_cast<rv_shm_header*>(base);
+    auto* slot = const_cast<rv_shm_slot*>(rv_shm_get_slot(base, ++sequence));
+    auto* slotRates = const_cast<float*>(rv_shm_get_rates(slot));
+
+    const uint32 count = (uint32) jlimit(0, maxChannels, numChannels);
+
+    // Seqlock: odd while the slot is being written
+    auto* lock = reinterpret_cast<std::atomic<uint64>*>(&slot->lock);
+    const uint64 lockValue = lock->load(std::memory_order_relaxed);
+
+    lock->store(lockValue + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->sequence = sequence;
+    slot->sample_number = sampleNumber;
+    slot->sample_rate = sampleRate;
+    slot->wall_time_ms = (int64) Time::getMillisecondCounter();
+    slot->num_channels = count;
+    memcpy(slotRates, rates, count * sizeof(float));
+
+    lock->store(lockValue + 2, std::memory_order_release);
+
+    reinterpret_cast<std::atomic<uint64>*>(&header->latest_sequence)->store(sequence, std::memory_order_release);
+}
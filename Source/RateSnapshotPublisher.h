@@ -0,0 +1,66 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RATESNAPSHOTPUBLISHER_H_INCLUDED
+#define RATESNAPSHOTPUBLISHER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+/**
+	Writes rate snapshots into a POSIX shared-memory ring for other
+	processes to read, using the layout in RateSnapshotShm.h.
+
+	Publishing costs one copy of the rates per snapshot; readers map the
+	object read-only and never block the writer. On platforms without
+	POSIX shared memory, open() fails and nothing is published.
+*/
+class RateSnapshotPublisher
+{
+public:
+	RateSnapshotPublisher() = default;
+	~RateSnapshotPublisher();
+
+	/** Creates (or recreates) the shared-memory object; returns false on failure */
+	bool open(const String& name, int maxChannels);
+
+	/** Unmaps and unlinks the object */
+	void close();
+
+	bool isOpen() const { return base != nullptr; }
+	const String& getName() const { return name; }
+	int getMaxChannels() const { return maxChannels; }
+
+	/** Writes the next snapshot; channels above the capacity are dropped */
+	void publish(const float* rates, int numChannels, int64 sampleNumber, double sampleRate);
+
+private:
+	String name;
+	void* base = nullptr;
+	size_t mappedSize = 0;
+	int maxChannels = 0;
+	uint64 sequence = 0;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RateSnapshotPublisher);
+};
+
+#endif // RATESNAPSHOTPUBLISHER_H_INCLUDED
@@ -0,0 +1,136 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+	Layout of the shared-memory ring the Rate Viewer publishes its rate
+	snapshots into. Plain C, so external readers can include it directly.
+
+	Each viewer publishes its own object, named RV_SHM_NAME_PREFIX followed
+	by an underscore and the viewer's node id (e.g. /openephys_rate_viewer_105).
+	The object holds an rv_shm_header
+	followed by num_slots slots of slot_size bytes. Each slot is an
+	rv_shm_slot followed by max_channels floats (Hz).
+
+	Every slot is guarded by a seqlock: the writer makes its lock odd,
+	writes the slot, then makes it even again. A reader copies the slot
+	and accepts the copy only if the lock was even and unchanged around
+	it. The header's latest_sequence names the newest complete snapshot,
+	found in slot latest_sequence % num_slots.
+
+	Readers never block the writer; rv_shm_read_latest() below is all a
+	reader needs once the object is mapped read-only.
+*/
+
+#ifndef RATESNAPSHOTSHM_H_INCLUDED
+#define RATESNAPSHOTSHM_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#define RV_SHM_NAME_PREFIX "/openephys_rate_viewer"
+#define RV_SHM_MAGIC 0x48535652u    /* "RVSH" */
+#define RV_SHM_VERSION 1u
+#define RV_SHM_NUM_SLOTS 4u
+
+typedef struct rv_shm_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_slots;
+	uint32_t max_channels;
+	uint64_t slot_size;            /* bytes per slot, a multiple of 64 */
+	uint64_t latest_sequence;      /* 0 until the first snapshot */
+	uint8_t reserved[32];          /* pads the header to 64 bytes */
+} rv_shm_header;
+
+typedef struct rv_shm_slot
+{
+	uint64_t lock;                 /* seqlock, odd while being written */
+	uint64_t sequence;             /* 1 for the first snapshot */
+	int64_t sample_number;         /* newest spike sample number when taken */
+	double sample_rate;            /* of the stream sample_number counts in */
+	int64_t wall_time_ms;          /* writer's millisecond counter */
+	uint32_t num_channels;         /* valid entries in rates */
+	uint32_t reserved;
+	/* float rates[max_channels] follows */
+} rv_shm_slot;
+
+static inline const rv_shm_slot* rv_shm_get_slot(const void* base, uint64_t sequence)
+{
+	const rv_shm_header* header = (const rv_shm_header*) base;
+	const uint8_t* slots = (const uint8_t*) base + sizeof(rv_shm_header);
+	return (const rv_shm_slot*) (slots + (sequence % header->num_slots) * header->slot_size);
+}
+
+static inline const float* rv_shm_get_rates(const rv_shm_slot* slot)
+{
+	return (const float*) (slot + 1);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/*
+	Copies the newest snapshot into info and rates (up to max_rates floats).
+	Returns the number of channels copied, 0 if nothing was published yet,
+	or -1 if the object is not a Rate Viewer ring of this version.
+*/
+static inline int rv_shm_read_latest(const void* base, rv_shm_slot* info, float* rates, uint32_t max_rates)
+{
+	const rv_shm_header* header = (const rv_shm_header*) base;
+
+	if (header->magic != RV_SHM_MAGIC || header->version != RV_SHM_VERSION)
+		return -1;
+
+	for (;;)
+	{
+		const uint64_t sequence = __atomic_load_n(&header->latest_sequence, __ATOMIC_ACQUIRE);
+
+		if (sequence == 0)
+			return 0;
+
+		const rv_shm_slot* slot = rv_shm_get_slot(base, sequence);
+		const uint64_t before = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+
+		if (before & 1u)
+			continue;
+
+		memcpy(info, slot, sizeof(rv_shm_slot));
+
+		uint32_t count = info->num_channels < max_rates ? info->num_channels : max_rates;
+
+		if (count > header->max_channels)
+			count = header->max_channels;
+
+		memcpy(rates, rv_shm_get_rates(slot), count * sizeof(float));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		/* A changed lock means the writer lapped the ring while we copied */
+		if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) == before && info->sequence == sequence)
+			return (int) count;
+	}
+}
+
+#endif
+
+#endif /* RATESNAPSHOTSHM_H_INCLUDED */
@@ -24,6 +24,7 @@
 #include "RateViewer.h"
 #include "RateViewerCanvas.h"
 #include "RateViewerEditor.h"
+#include "RateSnapshotShm.h"
 
 
 RateViewer::RateViewer()
@@ -38,12 +39,96 @@ RateViewer::RateViewer()
                     "window_size",
                     "Size of the window in ms",
                     1000, 100, 5000); // Default: 1000, Min: 100, Max: 5000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "flash_duration",
+                    "Time an electrode stays lit after a spike, in ms",
+                    200, 20, 2000); // Default: 200, Min: 20, Max: 2000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "flash_fade",
+                    "Fade-out time after the flash duration, in ms",
+                    0, 0, 2000); // Default: 0 (no fade), Min: 0, Max: 2000
+
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+                            "display_mode",
+                            "How electrode activity is drawn",
+                            { "Flash", "Heatmap", "Interpolated", "CV", "Synchrony", "Amplitude", "Evoked" },
+                            0);
+
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+                            "amplitude_stat",
+                            "Running statistic of peak-to-peak amplitude shown in Amplitude mode",
+                            { "Median", "Mean" },
+                            0);
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "max_amplitude",
+                    "Peak-to-peak amplitude at the top of the colour map, in uV",
+                    200, 10, 5000); // Default: 200, Min: 10, Max: 5000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "alarm_rate",
+                    "Rate above which a channel raises an alarm, in Hz (0 = off)",
+                    100, 0, 1000); // Default: 100, Min: 0 (off), Max: 1000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "alarm_duration",
+                    "Time a condition must hold before an alarm is raised or cleared, in ms",
+                    500, 100, 10000); // Default: 500, Min: 100, Max: 10000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "silent_time",
+                    "Time without spikes before a channel is flagged silent, in s (0 = off)",
+                    30, 0, 3600); // Default: 30, Min: 0 (off), Max: 3600
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "runaway_factor",
+                    "Multiple of the neighbours' mean rate that flags a runaway channel (0 = off)",
+                    5, 0, 100); // Default: 5, Min: 0 (off), Max: 100
+
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+                            "publish_rates",
+                            "Writes rate snapshots to a shared-memory ring for other processes",
+                            { "Off", "Shared memory" },
+                            0);
+
+    addCategoricalParameter(Parameter::GLOBAL_SCOPE,
+                            "ingestion",
+                            "Exact keeps every spike time; Coalesced hands over per-channel counts every 10 ms "
+                            "and leaves the CV, Synchrony and Amplitude modes without data",
+                            { "Exact", "Coalesced" },
+                            0);
+
+    addStringParameter(Parameter::GLOBAL_SCOPE,
+                       "psth_lines",
+                       "TTL lines whose onsets trigger the peri-stimulus histograms, e.g. 1,3-4 (empty = off)",
+                       "1");
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "psth_pre",
+                    "Peri-stimulus window before each trigger, in ms",
+                    100, 0, 2000); // Default: 100, Min: 0, Max: 2000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "psth_post",
+                    "Peri-stimulus window after each trigger, in ms",
+                    500, 10, 5000); // Default: 500, Min: 10, Max: 5000
+
+    addIntParameter(Parameter::GLOBAL_SCOPE,
+                    "psth_bin",
+                    "Peri-stimulus histogram bin size, in ms",
+                    10, 1, 500); // Default: 10, Min: 1, Max: 500
 }
 
 
 RateViewer::~RateViewer()
 {
+    stopTimer();
+    publishSubscription.reset();
 
+    if (rateEngine != nullptr)
+        rateEngine->removeFeeder(this);
 }
 
 
@@ -56,10 +141,38 @@ AudioProcessorEditor* RateViewer::createEditor()
 
 void RateViewer::updateSettings()
 {
+    alarmMonitor.setNumChannels(getTotalSpikeChannels());
+
+    if (isiStatistics.getNumChannels() != getTotalSpikeChannels())
+        isiStatistics.setNumChannels(getTotalSpikeChannels());
+
+    synchrony.setNumChannels(getTotalSpikeChannels());
+    psth.setNumChannels(getTotalSpikeChannels());
+    updatePsthSettings();  // Values loaded from a saved configuration arrive here
+    roiGroups.setNumChannels(getTotalSpikeChannels());
+
+    if (amplitudeStatistics.getNumChannels() != getTotalSpikeChannels())
+        amplitudeStatistics.setNumChannels(getTotalSpikeChannels());
+
+    if (spikeCounts.getNumChannels() != getTotalSpikeChannels())
+        spikeCounts.setNumChannels(getTotalSpikeChannels());
+
+    // Loaded settings only set the parameter, so the mode is applied here as well
+    coalesceSpikes = (int) getParameter("ingestion")->getValue() == 1;
+
+    updateAlarmSettings();
+    updateRateEngine();
+    updateRatePublisher();
+
     if (canvas != nullptr)
     {
         parameterValueChanged(getParameter("window_size"));
         parameterValueChanged(getParameter("max_rate"));
+        parameterValueChanged(getParameter("flash_duration"));
+        parameterValueChanged(getParameter("flash_fade"));
+        parameterValueChanged(getParameter("display_mode"));
+        parameterValueChanged(getParameter("amplitude_stat"));
+        parameterValueChanged(getParameter("max_amplitude"));
     }
 
 }
@@ -67,13 +180,29 @@ void RateViewer::updateSettings()
 
 void RateViewer::process(AudioBuffer<float>& buffer)
 {
+    // The framework allocates the spike objects, so only our own work is counted
     checkForEvents(true);
+
+    const AllocationCounter::ScopedCount countAllocations;
+    const uint32 now = Time::getMillisecondCounter();
+
+    alarmMonitor.advanceTo(now);
+
+    // Also flushes counts left over from a switch back to exact ingestion
+    if (spikeCounts.advanceTo(now))
+        triggerAsyncUpdate();
 }
 
 
 void RateViewer::handleTTLEvent(TTLEventPtr event)
 {
+    const AllocationCounter::ScopedCount countAllocations;
 
+    if (! event->getState() || ! psth.isActive())
+        return;
+
+    // Synchronised time, so triggers and spikes from different streams line up
+    psth.addTrigger(event->getLine(), event->getTimestampInSeconds() * 1000.0);
 }
 
 
@@ -85,23 +214,249 @@ void RateViewer::handleBroadcastMessage(String message)
 
 void RateViewer::saveCustomParametersToXml(XmlElement* parentElement)
 {
+    XmlElement* viewerState = parentElement->createNewChildElement("RATE_VIEWER");
+
+    const auto alarmSettings = alarmMonitor.getSettings();
 
+    for (int ch = 0; ch < (int) alarmSettings.channelThresholds.size(); ch++)
+    {
+        if (alarmSettings.channelThresholds[ch] <= 0.0f)
+            continue;
+
+        XmlElement* threshold = viewerState->createNewChildElement("ALARM_THRESHOLD");
+        threshold->setAttribute("channel", ch);
+        threshold->setAttribute("rate", alarmSettings.channelThresholds[ch]);
+    }
+
+    roiGroups.setAlarmThresholds(alarmSettings.groups);
+    roiGroups.saveToXml(viewerState);
+
+    if (auto* rateViewerEditor = (RateViewerEditor*) getEditor())
+        rateViewerEditor->saveViewerState(viewerState);
 }
 
 
 void RateViewer::loadCustomParametersFromXml(XmlElement* parentElement)
 {
+    XmlElement* viewerState = parentElement->getChildByName("RATE_VIEWER");
+
+    if (viewerState == nullptr)
+        return;
+
+    auto alarmSettings = alarmMonitor.getSettings();
+    alarmSettings.channelThresholds.clear();
+
+    for (auto* threshold : viewerState->getChildWithTagNameIterator("ALARM_THRESHOLD"))
+    {
+        const int ch = threshold->getIntAttribute("channel", -1);
 
+        if (ch < 0)
+            continue;
+
+        if (ch >= (int) alarmSettings.channelThresholds.size())
+            alarmSettings.channelThresholds.resize(ch + 1, 0.0f);
+
+        alarmSettings.channelThresholds[ch] = (float) threshold->getDoubleAttribute("rate");
+    }
+
+    roiGroups.loadFromXml(viewerState);
+    alarmSettings.groups = roiGroups.toAlarmGroups();
+
+    alarmMonitor.setSettings(alarmSettings);
+
+    if (auto* rateViewerEditor = (RateViewerEditor*) getEditor())
+        rateViewerEditor->loadViewerState(viewerState);
+}
+
+void RateViewer::updateAlarmSettings()
+{
+    auto alarmSettings = alarmMonitor.getSettings();
+
+    alarmSettings.alarmRate = (float) (int) getParameter("alarm_rate")->getValue();
+    alarmSettings.minDurationMs = (int) getParameter("alarm_duration")->getValue();
+    alarmSettings.silentMs = (int) getParameter("silent_time")->getValue() * 1000;
+    alarmSettings.runawayFactor = (float) (int) getParameter("runaway_factor")->getValue();
+
+    alarmMonitor.setSettings(alarmSettings);
+}
+
+int RateViewer::addRoiGroup(const ChannelBitset& members)
+{
+    // Keep thresholds edited in the alarm panel
+    roiGroups.setAlarmThresholds(alarmMonitor.getSettings().groups);
+
+    const int group = roiGroups.addGroup(roiGroups.getDefaultName(), members);
+    updateAlarmGroups();
+    return group;
+}
+
+void RateViewer::removeRoiGroup(int group)
+{
+    roiGroups.setAlarmThresholds(alarmMonitor.getSettings().groups);
+    roiGroups.removeGroup(group);
+    updateAlarmGroups();
+}
+
+void RateViewer::updateAlarmGroups()
+{
+    auto alarmSettings = alarmMonitor.getSettings();
+    alarmSettings.groups = roiGroups.toAlarmGroups();
+    alarmMonitor.setSettings(alarmSettings);
+}
+
+void RateViewer::updateRatePublisher()
+{
+    const bool enabled = (int) getParameter("publish_rates")->getValue() == 1;
+    const int numChannels = getTotalSpikeChannels();
+
+    if (! enabled || numChannels == 0)
+    {
+        ratePublisher.close();
+        updatePublishSubscription();
+        return;
+    }
+
+    // One object per viewer, so instances never unlink each other's
+    const String name = String(RV_SHM_NAME_PREFIX) + "_" + String(getNodeId());
+
+    // Readers size their buffers from the header, so a larger tree needs a new ring
+    if (! ratePublisher.isOpen() || ratePublisher.getName() != name || ratePublisher.getMaxChannels() < numChannels)
+    {
+        if (ratePublisher.open(name, numChannels))
+            LOGC("Rate Viewer ", getNodeId(), " publishing rate snapshots to shared memory ", name);
+        else
+            LOGE("Rate Viewer could not create shared memory ", name);
+    }
+
+    updatePublishSubscription();
+}
+
+void RateViewer::updatePublishSubscription()
+{
+    if (! ratePublisher.isOpen() || rateEngine == nullptr)
+    {
+        stopTimer();
+        publishSubscription.reset();
+        return;
+    }
+
+    const int windowMs = (int) getParameter("window_size")->getValue();
+
+    if (publishSubscription == nullptr
+        || publishSubscription->getEngine() != rateEngine.get()
+        || publishSubscription->getWindowMs() != windowMs)
+    {
+        // Subscribing first keeps a window the canvas shares alive
+        auto previous = std::move(publishSubscription);
+        publishSubscription = rateEngine->subscribe(windowMs);
+    }
+
+    if (! isTimerRunning())
+        startTimer(publishIntervalMs);
+}
+
+void RateViewer::timerCallback()
+{
+    if (publishSubscription == nullptr)
+        return;
+
+    const AllocationCounter::ScopedCount countAllocations;
+
+    // Shares the computation with any canvas showing the same window
+    const float* rates = publishSubscription->getRates(Time::getMillisecondCounter(), nullptr);
+
+    ratePublisher.publish(rates, publishSubscription->getEngine()->getNumChannels(),
+                          latestSampleNumber.load(std::memory_order_relaxed),
+                          latestSampleRate.load(std::memory_order_relaxed));
+}
+
+String RateViewer::getInputPath()
+{
+    StringArray path;
+
+    for (GenericProcessor* node = getSourceNode(); node != nullptr; node = node->getSourceNode())
+    {
+        // A merger's other input is not on this path
+        if (node->isMerger())
+            return String();
+
+        // Other viewers pass spikes through unchanged
+        if (dynamic_cast<RateViewer*>(node) == nullptr)
+            path.add(String(node->getNodeId()));
+    }
+
+    return path.joinIntoString("<");
+}
+
+void RateViewer::updateRateEngine()
+{
+    StringArray channelIdentities;
+
+    for (int i = 0; i < getTotalSpikeChannels(); i++)
+    {
+        const SpikeChannel* spikeChannel = spikeChannels[i];
+        channelIdentities.add(String(spikeChannel->getSourceNodeId()) + "/"
+                              + spikeChannel->getStreamName() + "/" + spikeChannel->getName());
+    }
+
+    // Only viewers fed by the same chain of processors see the same spikes. When that
+    // cannot be established, the engine is private to this viewer.
+    const String inputPath = getInputPath();
+    const String key = SharedRateEngine::makeKey(channelIdentities) + "@"
+                       + (inputPath.isNotEmpty() ? inputPath : "private " + String::toHexString((pointer_sized_int) this));
+
+    if (rateEngine != nullptr && rateEngine->getKey() == key)
+        return;
+
+    if (rateEngine != nullptr)
+        rateEngine->removeFeeder(this);
+
+    rateEngine = SharedRateEngine::getEngine(key, getTotalSpikeChannels());
+    rateEngine->addFeeder(this);
+
+    updatePublishSubscription();
+}
+
+void RateViewer::updatePsthSettings()
+{
+    PeriStimulusHistogram::Settings settings;
+
+    settings.lineMask = PeriStimulusHistogram::parseLineMask(getParameter("psth_lines")->getValue().toString());
+    settings.preMs = (int) getParameter("psth_pre")->getValue();
+    settings.postMs = (int) getParameter("psth_post")->getValue();
+    settings.binMs = (int) getParameter("psth_bin")->getValue();
+
+    psth.setSettings(settings);
 }
 
 void RateViewer::parameterValueChanged(Parameter* param)
 {
-   if (param->getName().equalsIgnoreCase("window_size"))
+   if (param->getName().startsWith("alarm_")
+       || param->getName().equalsIgnoreCase("silent_time")
+       || param->getName().equalsIgnoreCase("runaway_factor"))
+   {
+      updateAlarmSettings();
+   }
+   else if (param->getName().startsWith("psth_"))
+   {
+      updatePsthSettings();
+   }
+   else if (param->getName().equalsIgnoreCase("ingestion"))
+   {
+      coalesceSpikes = (int) param->getValue() == 1;
+   }
+   else if (param->getName().equalsIgnoreCase("publish_rates"))
+   {
+      updateRatePublisher();
+   }
+   else if (param->getName().equalsIgnoreCase("window_size"))
    {
       int windowSize = (int)param->getValue();
 
       if (canvas != nullptr)
             canvas->setWindowSizeMs(windowSize);  // Update window size in canvas
+
+      updatePublishSubscription();
    }
    else if (param->getName().equalsIgnoreCase("max_rate"))
    {
@@ -110,18 +465,78 @@ void RateViewer::parameterValueChanged(Parameter* param)
       if (canvas != nullptr)
             canvas->setMaxRate(max_rate);
    }
+   else if (param->getName().equalsIgnoreCase("flash_duration"))
+   {
+      if (canvas != nullptr)
+            canvas->setFlashDuration((int)param->getValue());
+   }
+   else if (param->getName().equalsIgnoreCase("flash_fade"))
+   {
+      if (canvas != nullptr)
+            canvas->setFlashFade((int)param->getValue());
+   }
+   else if (param->getName().equalsIgnoreCase("display_mode"))
+   {
+      const auto mode = (RateViewerCanvas::DisplayMode)(int)param->getValue();
+      synchrony.setEnabled(mode == RateViewerCanvas::DisplayMode::synchrony);
+
+      if (canvas != nullptr)
+            canvas->setDisplayMode(mode);
+   }
+   else if (param->getName().equalsIgnoreCase("amplitude_stat"))
+   {
+      if (canvas != nullptr)
+            canvas->setAmplitudeMedian((int)param->getValue() == 0);
+   }
+   else if (param->getName().equalsIgnoreCase("max_amplitude"))
+   {
+      if (canvas != nullptr)
+            canvas->setMaxAmplitude((int)param->getValue());
+   }
 }
 
 
 void RateViewer::handleSpike (SpikePtr spike)
 {
+    const AllocationCounter::ScopedCount countAllocations;
+
+    const SpikeChannel* spikeChannel = spike->getChannelInfo();
+
+    latestSampleNumber.store(spike->getSampleNumber(), std::memory_order_relaxed);
+    latestSampleRate.store(spikeChannel->getSampleRate(), std::memory_order_relaxed);
+
+    if (psth.isActive())
+        psth.addSpike(spikeChannel->getGlobalIndex(), spike->getTimestampInSeconds() * 1000.0);
+
+    // Bounded work per spike during bursts; spike times and waveforms are not kept
+    if (coalesceSpikes.load(std::memory_order_relaxed))
+    {
+        alarmMonitor.addSpike(spikeChannel->getGlobalIndex());
+        spikeCounts.addSpike(spikeChannel->getGlobalIndex());
+        return;
+    }
+
     int start1, size1, start2, size2;
     spikeFifo.prepareToWrite(1, start1, size1, start2, size2);
 
+    // Vectorized min/max over each electrode channel of the waveform
+    const float amplitude = AmplitudeStatistics::getPeakToPeak(spike->getDataPointer(),
+                                                               spikeChannel->getNumChannels(),
+                                                               spikeChannel->getTotalSamples());
+
+    const SpikeEvent event = { spikeChannel->getGlobalIndex(),
+                               spikeChannel->getSampleRate(),
+                               amplitude,
+                               spike->getSampleNumber(),
+                               spike->getTimestampInSeconds() * 1000.0,
+                               Time::getMillisecondCounter() };
+
+    alarmMonitor.addSpike(event.channel);
+
     if (size1 > 0)
-        spikeBuffer[start1] = {spike->getChannelInfo()->getGlobalIndex()};
+        spikeBuffer[start1] = event;
     if (size2 > 0)
-        spikeBuffer[start2] = {spike->getChannelInfo()->getGlobalIndex()};
+        spikeBuffer[start2] = event;
 
     spikeFifo.finishedWrite (size1 + size2);
 
@@ -130,34 +545,67 @@ void RateViewer::handleSpike (SpikePtr spike)
 
 void RateViewer::handleAsyncUpdate()
 {
-    if (! canvas)
-        return;
+    const AllocationCounter::ScopedCount countAllocations;
 
     int start1, size1, start2, size2;
-    spikeFifo.prepareToRead(1, start1, size1, start2, size2);
+    spikeFifo.prepareToRead(spikeFifo.getNumReady(), start1, size1, start2, size2);
 
-    if (size1 > 0)
+    // Statistics are kept whether or not the canvas is open
+    auto drain = [this](int start, int size)
     {
-        auto& evt = spikeBuffer[start1];
-        canvas->addSpike (evt.channel);
-    }
-    if (size2 > 0)
-    {
-        auto& evt = spikeBuffer[start2];
-        canvas->addSpike (evt.channel);
-    }
+        for (int i = 0; i < size; i++)
+        {
+            const SpikeEvent& event = spikeBuffer[start + i];
+            isiStatistics.addSpike(event.channel, event.sampleNumber, event.sampleRate);
+            synchrony.addSpike(event.channel, event.timeMs);
+            amplitudeStatistics.addAmplitude(event.channel, event.amplitude);
+            roiGroups.addSpikes(event.channel, 1);
+
+            if (rateEngine != nullptr)
+                rateEngine->addSpikes(this, event.channel, 1, event.receivedMs);
+
+            if (canvas)
+                canvas->addSpike(event.channel);
+        }
+    };
+
+    drain(start1, size1);
+    drain(start2, size2);
 
     spikeFifo.finishedRead (size1 + size2);
+
+    spikeCounts.drain([this](int channel, int count, uint32 binStartMs)
+    {
+        roiGroups.addSpikes(channel, count);
+
+        if (rateEngine != nullptr)
+            rateEngine->addSpikes(this, channel, count, binStartMs);
+
+        if (canvas)
+            canvas->addSpikes(channel, count);
+    });
 }
 
 bool RateViewer::startAcquisition()
 {
+   alarmMonitor.reset(Time::getMillisecondCounter());
+   isiStatistics.reset();
+   synchrony.reset();
+   psth.reset();
+   roiGroups.resetCounts();
+   amplitudeStatistics.reset();
+   spikeCounts.reset(Time::getMillisecondCounter());
+   AllocationCounter::reset();
    ((RateViewerEditor*)getEditor())->enable();
    return true;
 }
 
 bool RateViewer::stopAcquisition()
 {
+   if (AllocationCounter::isEnabled)
+      LOGC("Rate Viewer: ", (int64) AllocationCounter::getAllocationCount(), " heap allocations and ",
+           (int64) AllocationCounter::getFreeCount(), " frees on the acquisition paths");
+
    ((RateViewerEditor*)getEditor())->disable();
    return true;
 }
@@ -28,6 +28,17 @@
 #include <ProcessorHeaders.h>
 #include <JuceHeader.h> 
 
+#include "AllocationCounter.h"
+#include "AmplitudeStatistics.h"
+#include "ChannelAlarmMonitor.h"
+#include "IsiStatistics.h"
+#include "PeriStimulusHistogram.h"
+#include "RateSnapshotPublisher.h"
+#include "RoiGroups.h"
+#include "SharedRateEngine.h"
+#include "SpikeCountCoalescer.h"
+#include "SynchronyMatrix.h"
+
 class RateViewerCanvas; // <--- need to declare this class at the top of the file
 
 /**
@@ -36,7 +47,8 @@ class RateViewerCanvas; // <--- need to declare this class at the top of the fil
 */
 
 class RateViewer : public GenericProcessor,
-				   private juce::AsyncUpdater
+				   private juce::AsyncUpdater,
+				   private juce::Timer
 {
 public:
 	/** The class constructor, used to initialize any members.*/
@@ -95,13 +107,92 @@ public:
 
 	void handleAsyncUpdate() override;
 
+	/** Alarm state, updated on the processing thread */
+	ChannelAlarmMonitor& getAlarmMonitor() { return alarmMonitor; }
+
+	/** Interval statistics, updated on the message thread as spikes are drained */
+	const IsiStatistics& getIsiStatistics() const { return isiStatistics; }
+
+	/** Running spike amplitudes, updated as spikes are drained */
+	const AmplitudeStatistics& getAmplitudeStatistics() const { return amplitudeStatistics; }
+
+	/** Pairwise synchrony, computed on its own thread while the synchrony view is shown */
+	SynchronyMatrix& getSynchrony() { return synchrony; }
+
+	/** TTL-triggered histograms, accumulated on the processing thread */
+	const PeriStimulusHistogram& getPsth() const { return psth; }
+
+	/** Electrode groups and their aggregates, used on the message thread */
+	RoiGroups& getRoiGroups() { return roiGroups; }
+
+	/** Adds a group with a default name and makes it available to the alarms; returns its index or -1 */
+	int addRoiGroup(const ChannelBitset& members);
+	void removeRoiGroup(int group);
+
+	/** Rates shared with every other viewer of the same spike channels; null before the first update */
+	const std::shared_ptr<SharedRateEngine>& getRateEngine() const { return rateEngine; }
+
+	/** True while rate snapshots are written to shared memory */
+	bool isPublishingRates() const { return ratePublisher.isOpen(); }
+
+	/** Rate snapshots are published at this interval, whatever the canvas shows */
+	static constexpr int publishIntervalMs = 50;
+
 private:
 
+	/** Copies the alarm parameters into the monitor's settings */
+	void updateAlarmSettings();
+
+	/** Replaces the alarm monitor's groups with the ROI groups */
+	void updateAlarmGroups();
+
+	/** Opens or closes the shared-memory ring to match the publish_rates parameter */
+	void updateRatePublisher();
+
+	/** Subscribes the publisher to the rate engine with the current window, or drops it */
+	void updatePublishSubscription();
+
+	/** Publishes one rate snapshot, stamped with the newest drained spike */
+	void timerCallback() override;
+
+	/** Copies the psth_* parameters into the histograms' settings */
+	void updatePsthSettings();
+
+	/** Switches to the shared engine for the current spike channels and input */
+	void updateRateEngine();
+
+	/** Node ids upstream of this viewer, nearest first; empty if a merger is in the way */
+	String getInputPath();
+
+	ChannelAlarmMonitor alarmMonitor;
+	IsiStatistics isiStatistics;
+	AmplitudeStatistics amplitudeStatistics;
+	SynchronyMatrix synchrony;
+	PeriStimulusHistogram psth;
+	RoiGroups roiGroups;
+	RateSnapshotPublisher ratePublisher;
+	std::shared_ptr<SharedRateEngine> rateEngine;
+	std::unique_ptr<SharedRateEngine::Subscription> publishSubscription;
+
+	/** Per-bin spike counts, used instead of spikeFifo in coalesced ingestion.
+		Counts carry no spike times or waveforms, so ISI, synchrony and
+		amplitude statistics are not updated in that mode. */
+	SpikeCountCoalescer spikeCounts;
+	std::atomic<bool> coalesceSpikes{ false };
+
+	std::atomic<int64> latestSampleNumber{ 0 };
+	std::atomic<float> latestSampleRate{ 0.0f };
+
 	/** Generates an assertion if this class leaks */
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RateViewer);
 
 	struct SpikeEvent {
 		int channel;
+		float sampleRate;
+		float amplitude;
+		int64 sampleNumber;
+		double timeMs;         // synchronised across streams
+		uint32 receivedMs;     // Time::getMillisecondCounter() when handled, the rate engine's clock
 	};
 
 	static constexpr int maxSpikeBufferSize = 20000;
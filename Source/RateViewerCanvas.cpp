@@ -27,10 +27,50 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 RateViewerCanvas::RateViewerCanvas(RateViewer* processor_)
-	: processor(processor_)
+	: processor(processor_),
+      isiStatistics(processor_->getIsiStatistics()),
+      amplitudeStatistics(processor_->getAmplitudeStatistics())
 {
 	plt.setBounds(5, 5, 1500, 1000);
     refreshRate = 30;
+
+    for (int i = 0; i < (int) colourMap.size(); i++)
+    {
+        float normalizedRate = i / (float) (colourMap.size() - 1);
+        colourMap[i] = Colour::fromHSV((1.0f - normalizedRate) * 0.7f, 1.0f, 1.0f, 1.0f);
+        colourLut[i] = colourMap[i].getPixelARGB().getNativeARGB();
+    }
+
+    // Label updates during acquisition then only share these strings
+    rateLabelTexts.reserve(maxCachedLabelRate * 10 + 1);
+
+    for (int tenths = 0; tenths <= maxCachedLabelRate * 10; tenths++)
+        rateLabelTexts.push_back(String(tenths / 10.0f, 1));
+
+    shardJob = [this](int shardIndex) { processShard(rateShards[shardIndex]); };
+
+    // Results then copy into this without growing it
+    synchronyLinks.reserve(SynchronyMatrix::maxLinks);
+
+    subscribeRates();
+
+    alarmPanel = std::make_unique<AlarmPanel>(processor->getAlarmMonitor(), [this](int channel)
+    {
+        return channel < (int) channelRates.size() ? channelRates[channel] : 0.0f;
+    });
+    alarmPanel->onChannelSelected = [this](int channel) { selectChannel(channel); };
+    addAndMakeVisible(alarmPanel.get());
+
+    histogramView = std::make_unique<IsiHistogramView>(isiStatistics);
+    addChildComponent(histogramView.get());
+
+    synchronyView = std::make_unique<SynchronyMatrixView>();
+    addChildComponent(synchronyView.get());
+
+    psthView = std::make_unique<PsthView>(psthResult);
+    addChildComponent(psthView.get());
+
+    updateChannelCount();
 }
 
 
@@ -42,138 +82,821 @@ RateViewerCanvas::~RateViewerCanvas()
 void RateViewerCanvas::setWindowSizeMs(int windowSize_)
 {
     windowSize = windowSize_;
-    updateLayout();
+
+    // The old subscription is released last, so a window other canvases share is kept
+    auto previous = std::move(rateSubscription);
+    subscribeRates();
+}
+
+void RateViewerCanvas::setMaxAmplitude(int maxAmplitude_)
+{
+    maxAmplitude = maxAmplitude_;
+    repaint();
+}
+
+void RateViewerCanvas::setAmplitudeMedian(bool useMedian)
+{
+    useAmplitudeMedian = useMedian;
+    repaint();
 }
 
 void RateViewerCanvas::setMaxRate(int maxRate_)
 {
     maxRate = maxRate_;
+    invalidateLabels();
+    rasterDirty = true;
+}
+
+void RateViewerCanvas::setDisplayMode(DisplayMode mode)
+{
+    displayMode = mode;
+
+    synchronyView->setVisible(displayMode == DisplayMode::synchrony);
+    synchronyLinks.clear();
+    processor->getRoiGroups().clearSynchrony();
+
+    // The evoked view swaps the ISI histogram for the channel's PSTH
+    selectChannel(selectedChannel);
+
+    if (displayMode != DisplayMode::interpolated)
+    {
+        rasterizer.clear();
+        rasterGeometryValid = false;
+    }
+    else if (! rasterGeometryValid)
+    {
+        updateRasterGeometry();
+    }
+
+    rasterDirty = true;
+    ratesSettled = false;
+    repaint();
+}
+
+void RateViewerCanvas::updateRasterGeometry()
+{
+    // The weights take a while to build and a lot of memory; skip them unless needed
+    if (displayMode != DisplayMode::interpolated)
+        return;
+
+    // Only the part of the layout that is on screen
+    const AffineTransform view = getViewTransform();
+    const Rectangle<int> area = layoutBounds.transformedBy(view)
+                                            .getSmallestIntegerContainer()
+                                            .getIntersection(getPlotBounds());
+
+    rasterizer.setGeometry(area, electrodeGrid, view.inverted(), 1.0f / zoom);
+    rasterZoom = zoom;
+    rasterPan = pan;
+    rasterGeometryValid = true;
+    rasterDirty = true;
+}
+
+void RateViewerCanvas::setElectrodeLayout(const std::map<int, std::pair<float, float>>& positions)
+{
+    electrode_map = positions;
+    updateChannelCount();
+    updateLayout();
+}
+
+void RateViewerCanvas::updateChannelCount()
+{
+    const int numElectrodes = electrode_map.empty() ? 0 : electrode_map.rbegin()->first + 1;
+    const int numChannels = jmax(processor->getTotalSpikeChannels(), numElectrodes);
+
+    if (numChannels == (int) channelRates.size())
+        return;
+
+    channelRates.assign(numChannels, 0.0f);
+    displayedRates.resize(numChannels);
+    aboveMaxRate.assign(numChannels, 0);
+    flashStartTime.assign(numChannels, 0);
+    alarmFlags.assign(numChannels, 0);
+
+    channelColours.assign(numChannels, colourMap[0]);
+    invalidateLabels();
+
+    flashWheel.setNumTimers(numChannels);
+    activeFlashes.resize(numChannels);
+
+    alarmedChannels.resize(numChannels);
+    alarmVersion = processor->getAlarmMonitor().getStateVersion() - 1;
+
+    rateShards.resize((numChannels + channelsPerShard - 1) / channelsPerShard);
+
+    for (int i = 0; i < (int) rateShards.size(); i++)
+    {
+        rateShards[i].begin = i * channelsPerShard;
+        rateShards[i].end = jmin(numChannels, (i + 1) * channelsPerShard);
+        rateShards[i].dirtyChannels.reserve(channelsPerShard);
+    }
+
+    if (numChannels >= parallelChannelThreshold && workerPool == nullptr)
+        workerPool = std::make_unique<RateWorkerPool>(RateWorkerPool::getDefaultNumWorkers());
+}
+
+void RateViewerCanvas::invalidateLabels()
+{
+    std::fill(displayedRates.begin(), displayedRates.end(), std::numeric_limits<float>::quiet_NaN());
+    ratesSettled = false;
+}
+
+void RateViewerCanvas::applyFrameRate()
+{
+    const int targetHz = framePacer.getTargetHz();
+
+    if (targetHz == refreshRate || ! isTimerRunning())
+        return;
+
+    refreshRate = targetHz;
+    startTimerHz(targetHz);
 }
 
 void RateViewerCanvas::updateLayout()
 {
-    auto plotArea = Rectangle<int>(5, 5, windowSize, windowSize);
-    const float margin = 10.0f;
-    plotArea = plotArea.reduced(margin);
+    const int numElectrodes = electrode_map.empty() ? 0 : electrode_map.rbegin()->first + 1;
+
+    visibleElectrodes.forEach([this](int electrode) { electrodeLabels[electrode]->setVisible(false); });
+
+    plotPositions.assign(numElectrodes, {});
+    visibleElectrodes.resize(numElectrodes);
+    layoutBounds = {};
+
+    while (electrodeLabels.size() < numElectrodes)
+    {
+        auto* rate_text = electrodeLabels.add(new Label());
+        rate_text->setJustificationType(Justification::centred);
+        rate_text->setInterceptsMouseClicks(false, false);
+        addChildComponent(rate_text);
+    }
+    while (electrodeLabels.size() > numElectrodes)
+        electrodeLabels.removeLast();
 
-    float max_x = std::numeric_limits<float>::min();
+    if (electrode_map.empty() || getWidth() <= 0 || getHeight() <= 0)
+    {
+        electrodeGrid.build({});
+        updateView();
+        return;
+    }
+
+    float max_x = std::numeric_limits<float>::lowest();
     float min_x = std::numeric_limits<float>::max();
-    float max_y = std::numeric_limits<float>::min();
+    float max_y = std::numeric_limits<float>::lowest();
     float min_y = std::numeric_limits<float>::max();
 
-    for (const auto& [_, coord] : electrode_map) {
+    std::vector<ElectrodeGrid::Item> layoutItems;
+    layoutItems.reserve(electrode_map.size());
+
+    for (const auto& [idx, coord] : electrode_map) {
         max_x = std::max(max_x, coord.first);
         min_x = std::min(min_x, coord.first);
         max_y = std::max(max_y, coord.second);
         min_y = std::min(min_y, coord.second);
+        layoutItems.push_back({ coord.first, coord.second, idx });
     }
 
-    // Calculate minimum distances between electrodes
+    // Electrode pitch from each electrode's nearest neighbours
+    electrodeGrid.build(layoutItems);
+
     float min_dx = std::numeric_limits<float>::max();
     float min_dy = std::numeric_limits<float>::max();
-    
-    for (const auto& [id1, coord1] : electrode_map) {
-        for (const auto& [id2, coord2] : electrode_map) {
-            if (id1 != id2) {
-                float dx = std::abs(coord1.first - coord2.first);
-                float dy = std::abs(coord1.second - coord2.second);
-                if (dx > 0) min_dx = std::min(min_dx, dx);
-                if (dy > 0) min_dy = std::min(min_dy, dy);
-            }
+
+    for (const auto& [idx, coord] : electrode_map) {
+        int ids[5];
+        float distancesSquared[5];
+        const int found = electrodeGrid.findNearest(coord.first, coord.second, 5, ids, distancesSquared);
+
+        for (int k = 0; k < found; k++) {
+            float dx = std::abs(electrode_map[ids[k]].first - coord.first);
+            float dy = std::abs(electrode_map[ids[k]].second - coord.second);
+            if (dx > 0) min_dx = std::min(min_dx, dx);
+            if (dy > 0) min_dy = std::min(min_dy, dy);
         }
     }
 
-    // Calculate electrode size based on minimum distances
-    electrode_width = (min_dx / (max_x - min_x)) * plotArea.getWidth();
-    electrode_height = (min_dy / (max_y - min_y)) * plotArea.getHeight();
+    // Single rows or columns have no pitch along one axis
+    if (min_dx == std::numeric_limits<float>::max()) min_dx = min_dy;
+    if (min_dy == std::numeric_limits<float>::max()) min_dy = min_dx;
+    if (min_dx == std::numeric_limits<float>::max()) min_dx = min_dy = 1.0f;
 
-    int dx_text = 80 * electrode_width / 100.0f;
-    
-    screenCoordinates.clear();
-    while (electrodeLabels.size() < electrode_map.size())
-        electrodeLabels.add(new Label());
-    while (electrodeLabels.size() > electrode_map.size())
-        electrodeLabels.removeLast();
+    // Fit the layout (plus one electrode) to the canvas, keeping its aspect ratio
+    const float margin = 10.0f;
+    auto plotArea = getPlotBounds().toFloat().reduced(margin);
+    const float scale = jmin(plotArea.getWidth() / (max_x - min_x + min_dx),
+                             plotArea.getHeight() / (max_y - min_y + min_dy));
+
+    electrode_width = min_dx * scale;
+    electrode_height = min_dy * scale;
+
+    std::vector<ElectrodeGrid::Item> electrodeCentres;
+    electrodeCentres.reserve(electrode_map.size());
 
-    int labelIndex = 0;
     for (const auto& [idx, coord] : electrode_map) {
-        float norm_x = (coord.first - min_x) / (max_x - min_x);
-        float norm_y = (coord.second - min_y) / (max_y - min_y);
-        float screen_x = plotArea.getX() + norm_x * plotArea.getWidth();
-        float screen_y = plotArea.getY() + norm_y * plotArea.getHeight();
-        screenCoordinates[idx] = {screen_x, screen_y};
+        Point<float> position(plotArea.getX() + (coord.first - min_x) * scale,
+                              plotArea.getY() + (coord.second - min_y) * scale);
 
-        auto* rate_text = electrodeLabels[labelIndex++];
-        rate_text->setJustificationType(Justification::centred);
-        rate_text->setFont(Font(20.0f * electrode_width / 100.0f));
-        rate_text->setColour(Label::textColourId, Colours::white);
-        rate_text->setBounds((int)(screen_x + electrode_width/2 - dx_text/2),
-                       (int)(screen_y + electrode_height * 0.8),
-                       dx_text,
-                       (int)rate_text->getFont().getHeight());
-        addAndMakeVisible(rate_text);
-    }
-
-    electrodeImage = Image(Image::ARGB, getWidth(), getHeight(), true);
-    Graphics g(electrodeImage);
-    g.fillAll(Colours::transparentBlack);
-    
-    g.setColour(Colours::white.withAlpha(0.8f));
-    for (const auto& [idx, screen_coord] : screenCoordinates)
+        plotPositions[idx] = position;
+        layoutBounds = layoutBounds.getUnion({ position.x, position.y, electrode_width, electrode_height });
+
+        electrodeCentres.push_back({ position.x + electrode_width / 2,
+                                     position.y + electrode_height / 2,
+                                     idx });
+    }
+
+    electrodeGrid.build(electrodeCentres);
+    updateGroupBounds();
+
+    invalidateLabels();
+    updateView();
+}
+
+AffineTransform RateViewerCanvas::getViewTransform() const
+{
+    return AffineTransform::scale(zoom).translated(pan);
+}
+
+Rectangle<float> RateViewerCanvas::getElectrodeScreenBounds(int electrode) const
+{
+    const Point<float> position = plotPositions[electrode];
+
+    return { position.x * zoom + pan.x,
+             position.y * zoom + pan.y,
+             electrode_width * zoom,
+             electrode_height * zoom };
+}
+
+void RateViewerCanvas::updateView()
+{
+    const float screenWidth = electrode_width * zoom;
+    const float screenHeight = electrode_height * zoom;
+
+    useTiles = jmin(screenWidth, screenHeight) < minElectrodePixels;
+
+    visibleElectrodes.forEach([this](int electrode) { electrodeLabels[electrode]->setVisible(false); });
+    visibleElectrodes.clear();
+
+    // Electrode centres that can reach into the viewport
+    const Rectangle<float> viewport = getPlotBounds().toFloat()
+                                                      .transformedBy(getViewTransform().inverted())
+                                                      .expanded(electrode_width, electrode_height);
+
+    electrodeGrid.forEachInRect(viewport.getX(), viewport.getY(), viewport.getRight(), viewport.getBottom(),
+                                [this](int electrode) { visibleElectrodes.set(electrode); });
+
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+
+    if (electrodeImage.getWidth() != getWidth() || electrodeImage.getHeight() != getHeight())
+        electrodeImage = Image(Image::ARGB, getWidth(), getHeight(), true);
+    else
+        electrodeImage.clear(electrodeImage.getBounds());
+
+    if (useTiles)
     {
-        g.drawRect(screen_coord.first, 
-                  screen_coord.second, 
-                  electrode_width, 
-                  electrode_height,
-                  2.0f);
+        numTilesX = (getWidth() + tilePixels - 1) / tilePixels;
+        numTilesY = (getHeight() + tilePixels - 1) / tilePixels;
+        tileValueSums.resize((size_t) numTilesX * numTilesY);
+        tileCounts.resize((size_t) numTilesX * numTilesY);
+        tileFlashing.resize((size_t) numTilesX * numTilesY);
     }
-    
+    else
+    {
+        Graphics g(electrodeImage);
+        g.setColour(Colours::white.withAlpha(0.8f));
+
+        const Font labelFont(20.0f * screenWidth / 100.0f);
+        const bool showLabels = labelFont.getHeight() >= minLabelHeight;
+        const int dx_text = 80 * screenWidth / 100.0f;
+
+        visibleElectrodes.forEach([&](int electrode)
+        {
+            const Rectangle<float> bounds = getElectrodeScreenBounds(electrode);
+            g.drawRect(bounds, 2.0f);
+
+            if (! showLabels)
+                return;
+
+            auto* rate_text = electrodeLabels[electrode];
+            rate_text->setFont(labelFont);
+            rate_text->setBounds((int)(bounds.getCentreX() - dx_text/2),
+                                 (int)(bounds.getY() + bounds.getHeight() * 0.8),
+                                 dx_text,
+                                 (int)labelFont.getHeight());
+            rate_text->setVisible(true);
+        });
+    }
+
+    // The interpolated map is rebuilt once the view stops moving
+    rasterGeometryValid = false;
+    lastViewChangeTime = Time::getMillisecondCounter();
+
     repaint();
 }
 
+void RateViewerCanvas::zoomAround(Point<float> anchor, float factor)
+{
+    const float newZoom = jlimit(1.0f, maxZoom, zoom * factor);
+
+    // Keep the layout point under the anchor fixed on screen
+    pan = anchor - (anchor - pan) * (newZoom / zoom);
+    zoom = newZoom;
+
+    updateView();
+}
+
+void RateViewerCanvas::mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel)
+{
+    if (wheel.deltaY != 0.0f)
+        zoomAround(event.position, wheel.deltaY > 0.0f ? 1.15f : 1.0f / 1.15f);
+}
+
+void RateViewerCanvas::mouseDown(const MouseEvent& event)
+{
+    drawingGroup = event.mods.isShiftDown() && ! event.mods.isPopupMenu();
+    groupDragArea = {};
+    panAtDragStart = pan;
+}
+
+void RateViewerCanvas::mouseDrag(const MouseEvent& event)
+{
+    if (drawingGroup)
+    {
+        groupDragArea = Rectangle<float>(event.mouseDownPosition, event.position);
+        repaint();
+        return;
+    }
+
+    pan = panAtDragStart + event.getOffsetFromDragStart().toFloat();
+    updateView();
+}
+
+void RateViewerCanvas::mouseDoubleClick(const MouseEvent& event)
+{
+    zoom = 1.0f;
+    pan = {};
+    updateView();
+}
+
+void RateViewerCanvas::saveViewState(XmlElement* xml) const
+{
+    xml->setAttribute("zoom", zoom);
+    xml->setAttribute("pan_x", pan.x);
+    xml->setAttribute("pan_y", pan.y);
+}
+
+void RateViewerCanvas::loadViewState(const XmlElement* xml)
+{
+    zoom = jlimit(1.0f, maxZoom, (float) xml->getDoubleAttribute("zoom", 1.0));
+    pan = { (float) xml->getDoubleAttribute("pan_x", 0.0),
+            (float) xml->getDoubleAttribute("pan_y", 0.0) };
+    updateView();
+}
+
+Rectangle<int> RateViewerCanvas::getPlotBounds() const
+{
+    return getLocalBounds().withTrimmedRight(alarmPanelWidth);
+}
+
 void RateViewerCanvas::resized()
 {
+    alarmPanel->setBounds(getLocalBounds().removeFromRight(alarmPanelWidth));
+    histogramView->setBounds(getPlotBounds().removeFromBottom(150).removeFromLeft(380).reduced(10));
+    psthView->setBounds(histogramView->getBounds());
+    synchronyView->setBounds(getPlotBounds().removeFromTop(230).removeFromLeft(230).reduced(10));
+    updateLayout();
+}
+
+void RateViewerCanvas::updateAlarmFlags()
+{
+    const ChannelAlarmMonitor& monitor = processor->getAlarmMonitor();
+    const int numChannels = jmin((int) alarmFlags.size(), monitor.getNumChannels());
+
+    alarmedChannels.clear();
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        alarmFlags[ch] = monitor.getFlags(ch);
+
+        if (alarmFlags[ch] != 0)
+            alarmedChannels.set(ch);
+    }
+}
+
+bool RateViewerCanvas::showsChannelStatistic() const
+{
+    return displayMode == DisplayMode::cv
+        || displayMode == DisplayMode::amplitude
+        || displayMode == DisplayMode::evoked;
+}
+
+float RateViewerCanvas::getChannelStatistic(int channel) const
+{
+    if (displayMode == DisplayMode::cv)
+        return channel < isiStatistics.getNumChannels() ? isiStatistics.getCV(channel) : -1.0f;
+
+    // Suppressed responses show at the bottom of the map
+    if (displayMode == DisplayMode::evoked)
+        return psthResult.numTriggers > 0 && channel < psthResult.numChannels
+                   ? jmax(0.0f, psthResult.getResponse(channel))
+                   : -1.0f;
+
+    if (channel >= amplitudeStatistics.getNumChannels())
+        return -1.0f;
+
+    return useAmplitudeMedian ? amplitudeStatistics.getMedian(channel)
+                              : amplitudeStatistics.getMean(channel);
+}
+
+Colour RateViewerCanvas::getStatisticColour(float value) const
+{
+    if (value < 0.0f)
+        return Colours::darkgrey;
+
+    // CV: regular (0) to bursty (maxDisplayedCv); amplitude: 0 to max_amplitude; evoked: 0 to max_rate
+    const float top = displayMode == DisplayMode::cv        ? maxDisplayedCv
+                    : displayMode == DisplayMode::amplitude ? (float) maxAmplitude
+                                                            : (float) maxRate;
+    const float index = jmin(value / top, 1.0f) * (colourMap.size() - 1);
+    return colourMap[(size_t) index];
+}
+
+void RateViewerCanvas::selectChannel(int channel)
+{
+    selectedChannel = channel;
+
+    const bool evoked = displayMode == DisplayMode::evoked;
+    histogramView->setChannel(evoked ? -1 : channel);
+    psthView->setChannel(evoked ? channel : -1);
     repaint();
 }
 
+void RateViewerCanvas::paintLinks(Graphics& g)
+{
+    const int numPositions = (int) plotPositions.size();
+
+    for (const auto& link : synchronyLinks)
+    {
+        if (link.a >= numPositions || link.b >= numPositions
+            || electrode_map.count(link.a) == 0 || electrode_map.count(link.b) == 0)
+            continue;
+
+        // Links with neither end in view are culled
+        if (! visibleElectrodes.test(link.a) && ! visibleElectrodes.test(link.b))
+            continue;
+
+        const float strength = jlimit(0.0f, 1.0f, link.strength);
+        const Point<float> a = getElectrodeScreenBounds(link.a).getCentre();
+        const Point<float> b = getElectrodeScreenBounds(link.b).getCentre();
+
+        g.setColour(colourMap[(size_t) (strength * (colourMap.size() - 1))].withAlpha(0.3f + 0.7f * strength));
+        g.drawLine({ a, b }, 1.0f + 3.0f * strength);
+    }
+}
+
+void RateViewerCanvas::paintSelection(Graphics& g)
+{
+    if (selectedChannel < 0 || selectedChannel >= visibleElectrodes.size() || ! visibleElectrodes.test(selectedChannel))
+        return;
+
+    g.setColour(Colours::white);
+    g.drawRect(getElectrodeScreenBounds(selectedChannel).expanded(3.0f), 2.0f);
+}
+
+void RateViewerCanvas::mouseUp(const MouseEvent& event)
+{
+    if (drawingGroup)
+    {
+        drawingGroup = false;
+        addGroupFromArea(groupDragArea);
+        groupDragArea = {};
+        repaint();
+        return;
+    }
+
+    if (event.mouseWasDraggedSinceMouseDown() || ! getPlotBounds().contains(event.getPosition()))
+        return;
+
+    if (event.mods.isPopupMenu())
+    {
+        showGroupMenu(event.position);
+        return;
+    }
+
+    // The electrode whose centre is nearest the click, if the click is on it
+    const Point<float> plotPoint = event.position.transformedBy(getViewTransform().inverted());
+
+    int id;
+    float distanceSquared;
+
+    if (electrodeGrid.findNearest(plotPoint.x, plotPoint.y, 1, &id, &distanceSquared) == 1
+        && getElectrodeScreenBounds(id).contains(event.position))
+        selectChannel(id);
+    else
+        selectChannel(-1);
+}
+
+Colour RateViewerCanvas::getGroupColour(int group)
+{
+    // Golden-ratio hue steps keep neighbouring groups apart
+    return Colour::fromHSV(std::fmod(0.13f + group * 0.618034f, 1.0f), 0.55f, 1.0f, 1.0f);
+}
+
+void RateViewerCanvas::updateGroupBounds()
+{
+    const RoiGroups& groups = processor->getRoiGroups();
+
+    groupsVersion = groups.getVersion();
+    groupBounds.assign((size_t) groups.getNumGroups(), {});
+
+    for (int group = 0; group < groups.getNumGroups(); ++group)
+    {
+        Rectangle<float>& bounds = groupBounds[(size_t) group];
+
+        groups.getGroup(group).members.forEach([&](int electrode)
+        {
+            // Members missing from the current layout have no position
+            if (electrode_map.find(electrode) == electrode_map.end())
+                return;
+
+            const Rectangle<float> electrodeBounds(plotPositions[electrode].x, plotPositions[electrode].y,
+                                                   electrode_width, electrode_height);
+            bounds = bounds.isEmpty() ? electrodeBounds : bounds.getUnion(electrodeBounds);
+        });
+    }
+}
+
+void RateViewerCanvas::addGroupFromArea(Rectangle<float> screenArea)
+{
+    if (screenArea.isEmpty())
+        return;
+
+    const Rectangle<float> plotArea = screenArea.transformedBy(getViewTransform().inverted());
+
+    ChannelBitset members;
+    members.resize((int) plotPositions.size());
+
+    electrodeGrid.forEachInRect(plotArea.getX(), plotArea.getY(), plotArea.getRight(), plotArea.getBottom(),
+                                [&members](int electrode)
+    {
+        if (electrode < members.size())
+            members.set(electrode);
+    });
+
+    if (processor->addRoiGroup(members) >= 0)
+        updateGroupBounds();
+}
+
+void RateViewerCanvas::showGroupMenu(Point<float> position)
+{
+    const RoiGroups& groups = processor->getRoiGroups();
+    const AffineTransform view = getViewTransform();
+
+    PopupMenu menu;
+
+    for (int group = 0; group < (int) groupBounds.size() && group < groups.getNumGroups(); ++group)
+        if (groupBounds[(size_t) group].transformedBy(view).contains(position))
+            menu.addItem(group + 1, "Remove " + groups.getGroup(group).name);
+
+    if (menu.getNumItems() == 0)
+        return;
+
+    Component::SafePointer<RateViewerCanvas> safeThis(this);
+
+    menu.showMenuAsync(PopupMenu::Options(), [safeThis](int result)
+    {
+        if (safeThis == nullptr || result <= 0)
+            return;
+
+        safeThis->processor->removeRoiGroup(result - 1);
+        safeThis->updateGroupBounds();
+        safeThis->repaint();
+    });
+}
+
+void RateViewerCanvas::paintGroups(Graphics& g)
+{
+    const RoiGroups& groups = processor->getRoiGroups();
+    const AffineTransform view = getViewTransform();
+    const Rectangle<float> plotBounds = getPlotBounds().toFloat();
+
+    g.setFont(11.0f);
+
+    for (int group = 0; group < (int) groupBounds.size() && group < groups.getNumGroups(); ++group)
+    {
+        const Rectangle<float> bounds = groupBounds[(size_t) group].transformedBy(view).expanded(4.0f);
+
+        if (bounds.isEmpty() || ! bounds.intersects(plotBounds))
+            continue;
+
+        const RoiGroups::Aggregate& aggregate = groups.getAggregate(group);
+        const Colour colour = getGroupColour(group);
+
+        g.setColour(colour);
+        g.drawRoundedRectangle(bounds, 4.0f, 1.5f);
+
+        String caption = groups.getGroup(group).name
+                       + "  " + String(aggregate.meanRate, 1) + " Hz"
+                       + "  " + String(aggregate.totalRate, 0) + " sp/s"
+                       + "  " + String((int64) aggregate.spikeCount) + " spikes";
+
+        if (aggregate.synchrony >= 0.0f)
+            caption << "  sync " << String(aggregate.synchrony, 2);
+
+        const Rectangle<float> captionArea(bounds.getX(), bounds.getY() - 15.0f, jmax(bounds.getWidth(), 260.0f), 14.0f);
+
+        g.setColour(Colours::black.withAlpha(0.6f));
+        g.fillRect(captionArea.withWidth((float) g.getCurrentFont().getStringWidth(caption) + 6.0f));
+        g.setColour(colour);
+        g.drawText(caption, captionArea.translated(3.0f, 0.0f), Justification::centredLeft, false);
+    }
+
+    if (drawingGroup && ! groupDragArea.isEmpty())
+    {
+        g.setColour(Colours::white.withAlpha(0.15f));
+        g.fillRect(groupDragArea);
+        g.setColour(Colours::white);
+        g.drawRect(groupDragArea, 1.0f);
+    }
+}
+
+void RateViewerCanvas::paintAlarms(Graphics& g)
+{
+    alarmedChannels.forEach([&](int ch)
+    {
+        if (ch >= visibleElectrodes.size() || ! visibleElectrodes.test(ch))
+            return;
+
+        Rectangle<float> bounds = getElectrodeScreenBounds(ch);
+
+        // Stays visible when electrodes are smaller than a tile
+        if (useTiles)
+            bounds = bounds.withSizeKeepingCentre(jmax(bounds.getWidth(), (float) tilePixels),
+                                                  jmax(bounds.getHeight(), (float) tilePixels));
+
+        g.setColour(AlarmPanel::getAlarmColour(alarmFlags[ch]));
+        g.drawRect(bounds.expanded(1.0f), 2.0f);
+    });
+}
+
 void RateViewerCanvas::refreshState()
 {
+    invalidateLabels();
+    repaint();
+}
+
+void RateViewerCanvas::paintTiles(Graphics& g)
+{
+    std::fill(tileValueSums.begin(), tileValueSums.end(), 0.0f);
+    std::fill(tileCounts.begin(), tileCounts.end(), 0);
+    std::fill(tileFlashing.begin(), tileFlashing.end(), 0);
+
+    const int numChannels = (int) channelRates.size();
+
+    visibleElectrodes.forEach([&](int electrode)
+    {
+        const Point<float> centre = getElectrodeScreenBounds(electrode).getCentre();
+        const int tileX = (int) centre.x / tilePixels;
+        const int tileY = (int) centre.y / tilePixels;
+
+        if (centre.x < 0 || centre.y < 0 || tileX >= numTilesX || tileY >= numTilesY || electrode >= numChannels)
+            return;
 
+        const size_t tile = (size_t) tileY * numTilesX + tileX;
+        tileFlashing[tile] |= activeFlashes.test(electrode) ? 1 : 0;
+
+        if (showsChannelStatistic())
+        {
+            // Channels without a value yet do not count towards the mean
+            const float value = getChannelStatistic(electrode);
+
+            if (value < 0.0f)
+                return;
+
+            tileValueSums[tile] += value;
+        }
+        else
+        {
+            tileValueSums[tile] += channelRates[electrode];
+        }
+
+        tileCounts[tile]++;
+    });
+
+    const float colourScale = (colourMap.size() - 1) / (float) maxRate;
+
+    for (int tileY = 0; tileY < numTilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < numTilesX; tileX++)
+        {
+            const size_t tile = (size_t) tileY * numTilesX + tileX;
+
+            if (tileCounts[tile] == 0)
+                continue;
+
+            if (displayMode == DisplayMode::heatmap)
+            {
+                const float meanRate = tileValueSums[tile] / tileCounts[tile];
+                g.setColour(colourMap[(size_t) jmin(meanRate * colourScale, (float) (colourMap.size() - 1))]);
+            }
+            else if (showsChannelStatistic())
+            {
+                g.setColour(getStatisticColour(tileValueSums[tile] / tileCounts[tile]));
+            }
+            else
+            {
+                g.setColour(tileFlashing[tile] ? Colours::red : Colours::darkgrey);
+            }
+
+            g.fillRect(tileX * tilePixels, tileY * tilePixels, tilePixels - 1, tilePixels - 1);
+        }
+    }
 }
 
 void RateViewerCanvas::paintOverChildren(Graphics& g)
 {
+    const double paintStart = Time::getMillisecondCounterHiRes();
+
+    // Panned electrodes must not draw over the alarm panel
+    g.reduceClipRegion(getPlotBounds());
     g.drawImageAt(electrodeImage, 0, 0);
     
-    const float margin = 5.0f * electrode_width / 100.0f;
+    const float margin = 5.0f * electrode_width * zoom / 100.0f;
+    const int64 currentTime = Time::getMillisecondCounter();
 
-    if (useHeatmap)
-    { 
-        g.setColour(getHeatMapColor(channelRates));
+    if (displayMode == DisplayMode::synchrony)
+    {
+        paintLinks(g);
+        paintAlarms(g);
+        paintGroups(g);
+        paintSelection(g);
+        framePacer.addPaintCost(Time::getMillisecondCounterHiRes() - paintStart);
+        return;
     }
-    else
+
+    if (displayMode == DisplayMode::interpolated || useTiles)
     {
-        g.setColour(Colours::red);
+        if (displayMode != DisplayMode::interpolated)
+            paintTiles(g);
+
+        paintAlarms(g);
+        paintGroups(g);
+        paintSelection(g);
+        framePacer.addPaintCost(Time::getMillisecondCounterHiRes() - paintStart);
+        return;
     }
 
-    for (auto& kv : flashingflag)
+    if (showsChannelStatistic())
     {
-        int ch = kv.first;
-        bool flash = kv.second;
-        
-        if (flash && screenCoordinates.find(ch) != screenCoordinates.end())
+        visibleElectrodes.forEach([&](int ch)
         {
-            g.fillRect(screenCoordinates[ch].first + margin,
-                      screenCoordinates[ch].second + margin,
-                      electrode_width - 2 * margin,
-                      electrode_height - 10 * margin);
-        }
+            const Rectangle<float> bounds = getElectrodeScreenBounds(ch);
+
+            g.setColour(getStatisticColour(getChannelStatistic(ch)));
+            g.fillRect(bounds.getX() + margin,
+                       bounds.getY() + margin,
+                       bounds.getWidth() - 2 * margin,
+                       bounds.getHeight() - 10 * margin);
+        });
+
+        paintAlarms(g);
+        paintGroups(g);
+        paintSelection(g);
+        framePacer.addPaintCost(Time::getMillisecondCounterHiRes() - paintStart);
+        return;
     }
+
+    activeFlashes.forEach([&](int ch)
+    {
+        if (ch >= visibleElectrodes.size() || ! visibleElectrodes.test(ch))
+            return;
+
+        Colour colour = displayMode == DisplayMode::heatmap ? channelColours[ch] : Colours::red;
+
+        if (flashFadeMs > 0)
+        {
+            const int64 fadeStart = flashStartTime[ch] + flashDurationMs;
+            const float remaining = 1.0f - (currentTime - fadeStart) / (float) flashFadeMs;
+            colour = colour.withMultipliedAlpha(jlimit(0.0f, 1.0f, remaining));
+        }
+
+        const Rectangle<float> bounds = getElectrodeScreenBounds(ch);
+
+        g.setColour(colour);
+        g.fillRect(bounds.getX() + margin,
+                   bounds.getY() + margin,
+                   bounds.getWidth() - 2 * margin,
+                   bounds.getHeight() - 10 * margin);
+    });
+
+    paintAlarms(g);
+    paintGroups(g);
+    paintSelection(g);
+    framePacer.addPaintCost(Time::getMillisecondCounterHiRes() - paintStart);
 }
 
 void RateViewerCanvas::update()
 {
-
+    updateChannelCount();
 }
 
 
@@ -182,6 +905,18 @@ void RateViewerCanvas::paint(Graphics& g)
 
 	g.fillAll(Colours::black);
 
+    if (displayMode == DisplayMode::interpolated && ! rasterizer.isEmpty())
+    {
+        // Until the map is rebuilt for a new view, move the old one with it
+        const AffineTransform rasterToScreen = AffineTransform::translation((float) rasterizer.getArea().getX(),
+                                                                            (float) rasterizer.getArea().getY())
+                                                   .translated(-rasterPan)
+                                                   .scaled(zoom / rasterZoom)
+                                                   .translated(pan);
+
+        g.drawImageTransformed(rasterizer.getImage(), rasterToScreen);
+    }
+
 }
 
 void RateViewerCanvas::setPlotTitle(const String& title)
@@ -189,100 +924,224 @@ void RateViewerCanvas::setPlotTitle(const String& title)
     plt.title(title);
 }
 
-void RateViewerCanvas::addSpike(int channelId)
+void RateViewerCanvas::addSpikes(int channelId, int count)
 {
     int64 currentTime = Time::getMillisecondCounter();
-    spikeTimestamps[channelId].push_back(currentTime);
-    
-    flashingflag[channelId] = true;
-    flashEndTime[channelId] = Time::getMillisecondCounter() + 200;
+    spikesSinceLastFrame += count;
+    lastSpikeTime = currentTime;
+    ratesSettled = false;
+
+    if (channelId < 0 || channelId >= activeFlashes.size())
+        return;
+
+    flashStartTime[channelId] = currentTime;
+    flashWheel.schedule(channelId, currentTime + flashDurationMs + flashFadeMs);
+    activeFlashes.set(channelId);
 }
 
 
-void RateViewerCanvas::updateElectrodeLabels()
+void RateViewerCanvas::processShard(RateShard& shard)
 {
-    for (int i = 0; i < electrodeLabels.size(); ++i)
+    shard.dirtyChannels.clear();
+
+    // Channels the engine does not cover read as zero
+    const int sharedEnd = jlimit(shard.begin, shard.end, numSharedRates);
+
+    if (sharedRates != nullptr)
+        std::copy(sharedRates + shard.begin, sharedRates + sharedEnd, channelRates.data() + shard.begin);
+
+    std::fill(channelRates.data() + (sharedRates != nullptr ? sharedEnd : shard.begin),
+              channelRates.data() + shard.end, 0.0f);
+
+    const float colourScale = (colourMap.size() - 1) / (float) maxRate;
+
+    for (int ch = shard.begin; ch < shard.end; ++ch)
     {
-        if (channelRates.find(i) != channelRates.end())
-        {
-            float rate = channelRates[i];
-            electrodeLabels[i]->setText(String(rate, 1),
-                                   NotificationType::dontSendNotification);
-        }
-        else
+        const float rate = channelRates[ch];
+        const float shownRate = std::round(rate * 10.0f) / 10.0f;
+        const uint8 above = rate > maxRate ? 1 : 0;
+
+        channelColours[ch] = colourMap[(size_t) jmin(rate * colourScale, (float) (colourMap.size() - 1))];
+
+        // NaN never compares equal, so invalidated labels are always rewritten
+        if (shownRate != displayedRates[ch] || above != aboveMaxRate[ch])
         {
-            electrodeLabels[i]->setText("0.0",
-                                   NotificationType::dontSendNotification);
+            displayedRates[ch] = shownRate;
+            aboveMaxRate[ch] = above;
+            shard.dirtyChannels.push_back(ch);
         }
     }
 }
 
+void RateViewerCanvas::updateElectrodeLabel(int channel)
+{
+    if (channel >= electrodeLabels.size())
+        return;
+
+    Label* label = electrodeLabels[channel];
+    label->setText(getRateText(displayedRates[channel]), NotificationType::dontSendNotification);
+    label->setColour(Label::textColourId, aboveMaxRate[channel] ? Colours::red : Colours::white);
+}
+
+String RateViewerCanvas::getRateText(float rate) const
+{
+    const int tenths = (int) std::lround(rate * 10.0f);
+
+    if (tenths >= 0 && tenths < (int) rateLabelTexts.size())
+        return rateLabelTexts[(size_t) tenths];
+
+    return String(rate, 1);
+}
+
+bool RateViewerCanvas::updateRates(int64 currentTime)
+{
+    // The processor swaps engines when its spike channels change
+    if (rateSubscription == nullptr || rateSubscription->getEngine() != processor->getRateEngine().get())
+        subscribeRates();
+
+    if (rateSubscription == nullptr)
+        return false;
+
+    // Once a full window has passed without spikes, every rate stays at zero
+    if (ratesSettled)
+        return false;
+
+    // Computed once per bin for every viewer of these channels
+    sharedRates = rateSubscription->getRates(currentTime, workerPool.get());
+
+    if (workerPool != nullptr && channelRates.size() >= parallelChannelThreshold)
+        workerPool->run((int) rateShards.size(), shardJob);
+    else
+        for (auto& shard : rateShards)
+            processShard(shard);
+
+    bool changed = false;
+
+    for (const auto& shard : rateShards)
+    {
+        for (int channel : shard.dirtyChannels)
+            updateElectrodeLabel(channel);
+
+        changed = changed || ! shard.dirtyChannels.empty();
+    }
+
+    ratesSettled = currentTime - lastSpikeTime > windowSize + rateSubscription->getBinMs();
+
+    return changed;
+}
+
+void RateViewerCanvas::subscribeRates()
+{
+    const auto& engine = processor->getRateEngine();
+
+    rateSubscription = engine != nullptr ? engine->subscribe(windowSize) : nullptr;
+    sharedRates = nullptr;
+    numSharedRates = engine != nullptr ? engine->getNumChannels() : 0;
+    ratesSettled = false;
+}
+
 void RateViewerCanvas::refresh()
 {
+    const AllocationCounter::ScopedCount countAllocations;
+
+    const double frameStart = Time::getMillisecondCounterHiRes();
     int64 currentTime = Time::getMillisecondCounter();
-    int64 windowStart = currentTime - 1000;
 
-    for (auto& [channelId, timestamps] : spikeTimestamps)
+    const bool hadSpikes = spikesSinceLastFrame > 0;
+    spikesSinceLastFrame = 0;
+
+    if (! isShowing())
     {
-        while (!timestamps.empty() && timestamps.front() < windowStart)
-        {
-            timestamps.pop_front();
-        }
+        // Flashes keep expiring, so a tab shown again does not repaint stale ones
+        flashWheel.advance(currentTime, [this](int channel) { activeFlashes.reset(channel); });
 
-        float weightedSpikes = 0.0f;
-        
-        // Calculate weighted sum with exponential decay
-        for (const auto& timestamp : timestamps)
-        {
-            float timeDiff = (currentTime - timestamp) / 1000.0f; // Convert to seconds
-            float weight = std::exp(-timeDiff); // Exponential decay with time constant of 1 second
-            weightedSpikes += weight;
-        }
+        framePacer.tick(FramePacer::Activity::hidden, 0.0);
+        applyFrameRate();
+        return;
+    }
 
-        channelRates[channelId] = weightedSpikes;
+    bool changed = updateRates(currentTime) || hadSpikes;
+
+    RoiGroups& groups = processor->getRoiGroups();
+
+    if (groups.getVersion() != groupsVersion)
+    {
+        updateGroupBounds();
+        changed = true;
     }
-    
-    for (auto channel = flashEndTime.begin(); channel != flashEndTime.end();)
+
+    if (groups.getNumGroups() > 0)
+        groups.updateRates(channelRates.data(), (int) channelRates.size());
+
+    if (displayMode == DisplayMode::interpolated
+        && ! rasterGeometryValid
+        && currentTime - lastViewChangeTime > viewSettleMs)
+        updateRasterGeometry();
+
+    if (displayMode == DisplayMode::interpolated && (changed || rasterDirty))
     {
-        if (currentTime >= channel->second)
-        {
-            flashingflag[channel->first] = false;
-            channel = flashEndTime.erase(channel);
-        }
-        else ++channel;
+        rasterizer.render(channelRates.data(), (int) channelRates.size(), (float) maxRate, colourLut);
+        rasterDirty = false;
+        changed = true;
     }
 
-    updateElectrodeLabels();
-    repaint();
-}
+    if (displayMode == DisplayMode::synchrony
+        && processor->getSynchrony().getResult(synchronyVersion, synchronyMatrix, synchronyLinks, numSynchronyChannels))
+    {
+        synchronyView->setMatrix(synchronyMatrix, numSynchronyChannels, colourLut);
+        groups.updateSynchrony(synchronyMatrix, numSynchronyChannels);
+        changed = true;
+    }
 
-Colour RateViewerCanvas::getHeatMapColor(const std::map<int, float>& rates)
-{
-    float maxRate_ = 0.0f;
-    for (const auto& [_, rate] : rates)
+    if (displayMode == DisplayMode::evoked
+        && currentTime - lastPsthUpdate > psthUpdateMs
+        && processor->getPsth().getResult(psthVersion, psthResult))
     {
-        maxRate_ = std::max(maxRate_, rate);
+        lastPsthUpdate = currentTime;
+        changed = true;
     }
 
-    if (maxRate_ >= maxRate){
-        maxRate_ = maxRate;
+    const uint32 version = processor->getAlarmMonitor().getStateVersion();
+
+    if (version != alarmVersion)
+    {
+        alarmVersion = version;
+        updateAlarmFlags();
+        alarmPanel->alarmsChanged();
+        changed = true;
     }
-    
-    float totalRate = 0.0f;
-    for (const auto& [_, rate] : rates)
+
+    if (currentTime - lastAlarmPanelUpdate > alarmPanelUpdateMs)
     {
-        if(rate > maxRate){
-            totalRate += maxRate;
-        }
-        else{
-            totalRate += rate;
-        }
-        
+        lastAlarmPanelUpdate = currentTime;
+        alarmPanel->updateRates();
     }
-    float avgRate = totalRate / rates.size();
 
-    float normalizedRate = avgRate / maxRate_;
-    float hue = (1.0f - normalizedRate) * 0.7f;
-    return Colour::fromHSV(hue, 1.0f, 1.0f, 1.0f);
-}
+    flashWheel.advance(currentTime, [this, &changed](int channel)
+    {
+        activeFlashes.reset(channel);
+        changed = true;
+    });
+
+    // A fading flash looks different on every frame
+    if (flashFadeMs > 0 && activeFlashes.any())
+        changed = true;
+
+    if (changed)
+    {
+        repaint();
+
+        if (histogramView->isVisible())
+            histogramView->repaint();
+
+        if (psthView->isVisible())
+            psthView->repaint();
+    }
+
+    FramePacer::Activity activity = hadSpikes ? FramePacer::Activity::spiking
+                                  : changed   ? FramePacer::Activity::changed
+                                              : FramePacer::Activity::unchanged;
 
+    framePacer.tick(activity, Time::getMillisecondCounterHiRes() - frameStart);
+    applyFrameRate();
+}
@@ -27,6 +27,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <VisualizerWindowHeaders.h>
 #include <JuceHeader.h>
 
+#include "AlarmPanel.h"
+#include "AllocationCounter.h"
+#include "AmplitudeStatistics.h"
+#include "ChannelBitset.h"
+#include "ElectrodeGrid.h"
+#include "FramePacer.h"
+#include "HeatmapRasterizer.h"
+#include "IsiHistogramView.h"
+#include "PsthView.h"
+#include "SynchronyMatrixView.h"
+#include "RateWorkerPool.h"
+#include "SharedRateEngine.h"
+#include "TimingWheel.h"
+
 class RateViewer;
 
 /**
@@ -38,6 +52,18 @@ class RateViewerCanvas : public Visualizer
 {
 public:
 
+	/** How electrode activity is drawn; matches the order of the display_mode parameter */
+	enum class DisplayMode
+	{
+		flash,          // electrodes flash red on each spike
+		heatmap,        // flashes are coloured by the electrode's rate
+		interpolated,   // continuous map interpolated between electrodes
+		cv,             // electrodes coloured by the CV of their intervals
+		synchrony,      // pairwise synchrony matrix and links between electrodes
+		amplitude,      // electrodes coloured by their running spike amplitude
+		evoked          // electrodes coloured by their TTL-evoked response
+	};
+
 	/** Constructor */
 	RateViewerCanvas(RateViewer* processor);
 
@@ -63,18 +89,54 @@ public:
 	void setPlotTitle(const String& title);
 
 	/** Adds a spike sample number */
-	void addSpike(int channelId);
+	void addSpike(int channelId) { addSpikes(channelId, 1); }
+
+	/** Adds several spikes on one channel at once, as coalesced ingestion hands them over */
+	void addSpikes(int channelId, int count);
 
 	void paintOverChildren(Graphics& g);
 
 	void setWindowSizeMs(int windowSize_);
     void setMaxRate(int maxRate_);
+
+	/** Amplitude at the top of the colour map, in the waveform's units (usually uV) */
+	void setMaxAmplitude(int maxAmplitude);
+
+	/** Colours by the running median amplitude, or by the mean if false */
+	void setAmplitudeMedian(bool useMedian);
+
+	/** Sets how long an electrode stays lit after a spike */
+	void setFlashDuration(int durationMs) { flashDurationMs = durationMs; }
+
+	/** Sets how long a flash takes to fade out after its duration (0 = no fade) */
+	void setFlashFade(int fadeMs) { flashFadeMs = fadeMs; }
+
+	/** Replaces the electrode positions and rebuilds the layout */
+	void setElectrodeLayout(const std::map<int, std::pair<float, float>>& positions);
 	
 	OwnedArray<Label> electrodeLabels;
 
 	std::map<int, std::pair<float, float>> electrode_map;
 
-	void setUseHeatmap(bool useHeatmap_) { useHeatmap = useHeatmap_; }
+	void setDisplayMode(DisplayMode mode);
+
+	/** Zooms with the mouse wheel around the cursor */
+	void mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel) override;
+
+	/** Drags pan the view, shift-drags draw a new electrode group; a double click resets the view */
+	void mouseDown(const MouseEvent& event) override;
+	void mouseDrag(const MouseEvent& event) override;
+	void mouseDoubleClick(const MouseEvent& event) override;
+
+	/** A click on an electrode selects it and shows its ISI histogram; a right click on a group offers to remove it */
+	void mouseUp(const MouseEvent& event) override;
+
+	/** Selects a channel for the histogram view; -1 clears the selection */
+	void selectChannel(int channel);
+
+	/** Saves and restores the zoom and pan */
+	void saveViewState(XmlElement* xml) const;
+	void loadViewState(const XmlElement* xml);
 
 private:
 	/** Pointer to the processor class */
@@ -86,25 +148,230 @@ private:
 	/** Generates an assertion if this class leaks */
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RateViewerCanvas);
 
-	void updateElectrodeLabels();
+	/** Channel range updated as one unit of the per-frame rate pass */
+	struct alignas(cacheLineSize) RateShard
+	{
+		int begin = 0;
+		int end = 0;
+
+		/** Channels whose label or threshold state changed this frame */
+		std::vector<int> dirtyChannels;
+	};
+
+	/** Computes rates, threshold state and colours for one shard */
+	void processShard(RateShard& shard);
+
+	/** Runs the rate pass over every shard; returns true if any channel changed */
+	bool updateRates(int64 currentTime);
+
+	/** Subscribes to the processor's rate engine with the current window */
+	void subscribeRates();
+
+	/** Forces every label to be rewritten on the next frame */
+	void invalidateLabels();
+
+	/** Restarts the refresh timer if the pacer picked a new rate */
+	void applyFrameRate();
+
+	void updateElectrodeLabel(int channel);
+
+	/** Fits the layout to the canvas and rebuilds the spatial index */
 	void updateLayout();
 
+	/** Finds the electrodes in the viewport and redraws their outlines and labels */
+	void updateView();
+
+	/** Zooms by a factor, keeping the point under the anchor in place */
+	void zoomAround(Point<float> anchor, float factor);
+
+	/** Maps layout (plot) coordinates to the screen */
+	AffineTransform getViewTransform() const;
+	Rectangle<float> getElectrodeScreenBounds(int electrode) const;
+
+	/** Draws visible electrodes aggregated into fixed-size tiles */
+	void paintTiles(Graphics& g);
+
+	/** Outlines visible alarmed electrodes */
+	void paintAlarms(Graphics& g);
+
+	/** Outlines the selected electrode */
+	void paintSelection(Graphics& g);
+
+	/** Outlines each electrode group with its aggregate rates, spike count and synchrony */
+	void paintGroups(Graphics& g);
+
+	/** Recomputes the groups' outlines after the groups or the layout change */
+	void updateGroupBounds();
+
+	/** Adds a group with the electrodes whose centres lie in a screen rectangle */
+	void addGroupFromArea(Rectangle<float> screenArea);
+
+	/** Lists the groups under a point for removal */
+	void showGroupMenu(Point<float> position);
+
+	static Colour getGroupColour(int group);
+
+	/** Draws the strongest synchrony links between electrodes in view */
+	void paintLinks(Graphics& g);
+
+	/** True in the modes that colour electrodes by a per-channel statistic (CV, amplitude, evoked) */
+	bool showsChannelStatistic() const;
+
+	/** The current mode's statistic for a channel; negative if it has none yet */
+	float getChannelStatistic(int channel) const;
+
+	/** Colour for a statistic; negative values are grey */
+	Colour getStatisticColour(float value) const;
+
+	/** Copies the monitor's published alarm flags */
+	void updateAlarmFlags();
+
+	/** Canvas area left of the alarm panel */
+	Rectangle<int> getPlotBounds() const;
+
+	/** Sizes the per-channel state for the current spike channels and electrodes */
+	void updateChannelCount();
+
+	/** Below this size on screen, electrodes are drawn as aggregated tiles */
+	static constexpr float minElectrodePixels = 6.0f;
+	static constexpr int tilePixels = 8;
+
+	/** Labels smaller than this are not shown */
+	static constexpr float minLabelHeight = 6.0f;
+
+	static constexpr float maxZoom = 64.0f;
+
+	/** How long the view has to stay still before the interpolated map is rebuilt */
+	static constexpr int viewSettleMs = 150;
+
+	static constexpr int alarmPanelWidth = 320;
+
+	/** CV at the top of the colour map */
+	static constexpr float maxDisplayedCv = 2.0f;
+	static constexpr int alarmPanelUpdateMs = 500;
+
+	/** How often the evoked view copies the peri-stimulus histograms */
+	static constexpr int psthUpdateMs = 250;
+
+	/** Multiple of a cache line's worth of floats */
+	static constexpr int channelsPerShard = 256;
+
+	/** Channel count above which shards are run on the worker pool */
+	static constexpr int parallelChannelThreshold = 1024;
+
 	int windowSize = 1000;
 	int maxRate = 50;
 	float electrode_width = 10;
 	float electrode_height = 10;
 
-	bool useHeatmap = false;
-
-	std::map<int, std::deque<int64_t>> spikeTimestamps;
-	std::map<int, float> channelRates;
-	std::map<int,uint32_t> flashEndTime;
-    std::map<int,bool> flashingflag;
-	std::map<int, std::pair<float, float>> screenCoordinates;
+	DisplayMode displayMode = DisplayMode::flash;
+
+	/** This canvas's hold on the processor's shared rate engine */
+	std::unique_ptr<SharedRateEngine::Subscription> rateSubscription;
+	const float* sharedRates = nullptr;
+	int numSharedRates = 0;
+
+	std::unique_ptr<RateWorkerPool> workerPool;
+	std::vector<RateShard> rateShards;
+	std::function<void(int)> shardJob;
+
+	/** Per-channel state; sized in updateChannelCount(), never while acquiring */
+	CacheAlignedVector<float> channelRates;
+	CacheAlignedVector<float> displayedRates;
+	CacheAlignedVector<uint8> aboveMaxRate;
+	CacheAlignedVector<Colour> channelColours;
+
+	/** Label texts for every displayed rate up to maxCachedLabelRate, in 0.1 Hz steps */
+	std::vector<String> rateLabelTexts;
+	static constexpr int maxCachedLabelRate = 1000;
+
+	/** Text for a rate already rounded to 0.1 Hz; shares a cached string when it can */
+	String getRateText(float rate) const;
+
+	/** Heatmap colours from 0 to max_rate */
+	std::array<Colour, 256> colourMap;
+	std::array<uint32, 256> colourLut;
+
+	/** Electrode centres in plot coordinates, for neighbour and viewport searches */
+	ElectrodeGrid electrodeGrid;
+
+	/** Top-left corner of each electrode in plot coordinates, indexed by electrode */
+	std::vector<Point<float>> plotPositions;
+	Rectangle<float> layoutBounds;
+
+	/** Screen = plot * zoom + pan */
+	float zoom = 1.0f;
+	Point<float> pan;
+	Point<float> panAtDragStart;
+	int64 lastViewChangeTime = 0;
+
+	/** Electrodes that overlap the viewport */
+	ChannelBitset visibleElectrodes;
+
+	bool useTiles = false;
+	int numTilesX = 0;
+	int numTilesY = 0;
+	std::vector<float> tileValueSums;       // rates or CVs, depending on the display mode
+	std::vector<uint16> tileCounts;
+	std::vector<uint8> tileFlashing;
+
+	HeatmapRasterizer rasterizer;
+	bool rasterGeometryValid = false;
+	bool rasterDirty = true;
+
+	/** View the interpolated map was built for */
+	float rasterZoom = 1.0f;
+	Point<float> rasterPan;
+
+	/** Builds the interpolation weights if the interpolated map is shown */
+	void updateRasterGeometry();
+
+	FramePacer framePacer;
+	int spikesSinceLastFrame = 0;
+	int64 lastSpikeTime = 0;
+
+	/** True once every rate has decayed to zero and the labels show it */
+	bool ratesSettled = false;
+
+	/** Expires each electrode's flash; only channels that change state are touched */
+	TimingWheel flashWheel;
+	ChannelBitset activeFlashes;
+	std::vector<int64> flashStartTime;
+	int flashDurationMs = 200;
+	int flashFadeMs = 0;
+
+	const IsiStatistics& isiStatistics;
+	const AmplitudeStatistics& amplitudeStatistics;
+	int maxAmplitude = 200;
+	bool useAmplitudeMedian = true;
+	std::unique_ptr<IsiHistogramView> histogramView;
+	int selectedChannel = -1;
+
+	std::unique_ptr<SynchronyMatrixView> synchronyView;
+	std::vector<float> synchronyMatrix;
+	std::vector<SynchronyMatrix::Link> synchronyLinks;
+	int numSynchronyChannels = 0;
+	uint32 synchronyVersion = 0;
+
+	std::unique_ptr<PsthView> psthView;
+	PeriStimulusHistogram::Result psthResult;
+	uint32 psthVersion = 0;
+	int64 lastPsthUpdate = 0;
+
+	/** Group outlines in plot coordinates, by group */
+	std::vector<Rectangle<float>> groupBounds;
+	uint32 groupsVersion = 0;
+
+	bool drawingGroup = false;
+	Rectangle<float> groupDragArea;
+
+	std::unique_ptr<AlarmPanel> alarmPanel;
+	std::vector<uint8> alarmFlags;
+	ChannelBitset alarmedChannels;
+	uint32 alarmVersion = 0;
+	int64 lastAlarmPanelUpdate = 0;
 	
 	Image electrodeImage;
-
-	Colour getHeatMapColor(const std::map<int, float>& rates);
 };
 
 #endif // SPECTRUMCANVAS_H_INCLUDED
\ No newline at end of file
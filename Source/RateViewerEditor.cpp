@@ -26,13 +26,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "RateViewerCanvas.h"
 #include "RateViewer.h"
 
-#include <yaml-cpp/yaml.h>
 #include <juce_core/juce_core.h>
 
 #include "../../../plugin-GUI/Source/Utils/Utils.h"
 
 RateViewerEditor::RateViewerEditor(GenericProcessor* p)
-    : VisualizerEditor(p, "Rate Viewer", 210)
+    : VisualizerEditor(p, "Rate Viewer", 990)
 {
     electrodelayout = std::make_unique<ComboBox>("Electrode Layout List");
     electrodelayout->addListener(this);
@@ -58,12 +57,21 @@ RateViewerEditor::RateViewerEditor(GenericProcessor* p)
 
     addTextBoxParameterEditor("window_size", 15, 70);
     addTextBoxParameterEditor("max_rate", 120, 70);
- 
-    heatmapToggle = std::make_unique<ToggleButton>("Heatmap");
-    heatmapToggle->addListener(this);
-    heatmapToggle->setBounds(70, 25, 100, 20);
-    heatmapToggle->setToggleState(false, juce::dontSendNotification);
-    addAndMakeVisible(heatmapToggle.get());
+    addTextBoxParameterEditor("flash_duration", 215, 25);
+    addTextBoxParameterEditor("flash_fade", 215, 70);
+    addComboBoxParameterEditor("display_mode", 310, 25);
+    addComboBoxParameterEditor("publish_rates", 310, 70);
+    addTextBoxParameterEditor("alarm_rate", 410, 25);
+    addTextBoxParameterEditor("alarm_duration", 410, 70);
+    addTextBoxParameterEditor("silent_time", 505, 25);
+    addTextBoxParameterEditor("runaway_factor", 505, 70);
+    addComboBoxParameterEditor("amplitude_stat", 600, 25);
+    addTextBoxParameterEditor("max_amplitude", 600, 70);
+    addComboBoxParameterEditor("ingestion", 700, 25);
+    addTextBoxParameterEditor("psth_lines", 700, 70);
+    addTextBoxParameterEditor("psth_pre", 800, 25);
+    addTextBoxParameterEditor("psth_post", 800, 70);
+    addTextBoxParameterEditor("psth_bin", 895, 25);
 
     initDebugLog();
 }
@@ -111,22 +119,27 @@ Visualizer* RateViewerEditor::createNewCanvas()
     rateViewerNode->canvas = rateViewerCanvas;
     rateViewerCanvas->setWindowSizeMs(rateViewerNode->getParameter("window_size")->getValue());
     rateViewerCanvas->setMaxRate(rateViewerNode->getParameter("max_rate")->getValue());
+    rateViewerCanvas->setFlashDuration(rateViewerNode->getParameter("flash_duration")->getValue());
+    rateViewerCanvas->setFlashFade(rateViewerNode->getParameter("flash_fade")->getValue());
+    rateViewerCanvas->setDisplayMode((RateViewerCanvas::DisplayMode)(int) rateViewerNode->getParameter("display_mode")->getValue());
+    rateViewerCanvas->setAmplitudeMedian((int) rateViewerNode->getParameter("amplitude_stat")->getValue() == 0);
+    rateViewerCanvas->setMaxAmplitude(rateViewerNode->getParameter("max_amplitude")->getValue());
+
+    if (currentLayout != nullptr)
+        applyLayout(currentLayout);
+
+    if (pendingViewState != nullptr)
+    {
+        rateViewerCanvas->loadViewState(pendingViewState.get());
+        pendingViewState = nullptr;
+    }
+
     return rateViewerCanvas;
 }
 
 void RateViewerEditor::buttonClicked(Button* button)
 {
-    if (button == heatmapToggle.get())
-    {
-        RateViewer* RateViewerNode = (RateViewer*) getProcessor();
-        RateViewerCanvas* canvas = (RateViewerCanvas*) RateViewerNode->canvas;
-        if (canvas != nullptr)
-        {
-            canvas->setUseHeatmap(heatmapToggle->getToggleState());
-            canvas->repaint();
-        }
-    }
-    else if (button == loadFileButton.get())
+    if (button == loadFileButton.get())
     {
         FileChooser chooser("Select a YAML layout file...",
                           File::getSpecialLocation(File::userHomeDirectory),
@@ -174,43 +187,107 @@ void RateViewerEditor::comboBoxChanged(ComboBox* comboBox)
 
 void RateViewerEditor::loadYamlFile(const String& filename)
 {
-    
-    File yamlFile(filename); 
-    YAML::Node config = YAML::LoadFile(filename.toStdString());
+    auto layout = ElectrodeLayout::parseYaml(File(filename));
 
-    auto pos_node = config["pos"];
+    if (layout == nullptr)
+    {
+        writeToDebugLog("Could not read layout file " + filename);
+        return;
+    }
+
+    layout->writeCompiled();
+    applyLayout(layout);
+}
+
+void RateViewerEditor::applyLayout(std::shared_ptr<ElectrodeLayout> layout)
+{
+    currentLayout = layout;
 
-    int nodeIndex = 0;
     if (auto* rv = dynamic_cast<RateViewer*>(getProcessor()))
     {
+        rv->getAlarmMonitor().setNeighbours(layout->positions);
+
         if (auto* c = rv->canvas)
-        {
-            c->electrode_map.clear();
-            c->electrodeLabels.clear();
-            for (auto node : pos_node)
-            {
-                if (node[0].IsNull() || node[1].IsNull()) 
-                {
-                    continue;
-                } 
-                else {
-                    float x = node[0].as<float>();
-                    float y = node[1].as<float>();
-                    c->electrode_map[nodeIndex] = {x, y};
-                    c->electrodeLabels.add(new Label());
-                }
-                nodeIndex++;
-            }     
-        }
+            c->setElectrodeLayout(layout->positions);
     }
+}
 
-    if (auto* rv = dynamic_cast<RateViewer*>(getProcessor()))
+void RateViewerEditor::saveViewerState(XmlElement* xml)
+{
+    for (const auto& [itemId, path] : layoutFiles)
     {
-        if (auto* c = rv->canvas)
-        {
-            c->setWindowSizeMs(1000);
-        }
+        XmlElement* layoutFile = xml->createNewChildElement("LAYOUT_FILE");
+        layoutFile->setAttribute("id", itemId);
+        layoutFile->setAttribute("path", path);
+    }
+
+    if (currentLayout != nullptr)
+    {
+        XmlElement* layout = xml->createNewChildElement("LAYOUT");
+        layout->setAttribute("path", currentLayout->sourceFile);
+        layout->setAttribute("hash", currentLayout->contentHash);
+        layout->setAttribute("selected", electrodelayout->getSelectedId());
+    }
+
+    RateViewer* rv = (RateViewer*) getProcessor();
+
+    if (rv->canvas != nullptr)
+        rv->canvas->saveViewState(xml->createNewChildElement("VIEW"));
+    else if (pendingViewState != nullptr)
+        xml->addChildElement(new XmlElement(*pendingViewState));
+}
+
+void RateViewerEditor::loadViewerState(XmlElement* xml)
+{
+    electrodelayout->clear(dontSendNotification);
+    layoutFiles.clear();
+
+    for (auto* layoutFile : xml->getChildWithTagNameIterator("LAYOUT_FILE"))
+    {
+        const int itemId = layoutFile->getIntAttribute("id");
+        const String path = layoutFile->getStringAttribute("path");
+
+        electrodelayout->addItem(File(path).getFileName(), itemId);
+        layoutFiles[itemId] = path;
     }
+
+    currentLayout = nullptr;
+
+    // The view is applied when the canvas exists
+    if (XmlElement* view = xml->getChildByName("VIEW"))
+    {
+        RateViewer* rv = (RateViewer*) getProcessor();
+
+        if (rv->canvas != nullptr)
+            rv->canvas->loadViewState(view);
+        else
+            pendingViewState = std::make_unique<XmlElement>(*view);
+    }
+
+    XmlElement* layout = xml->getChildByName("LAYOUT");
+
+    if (layout == nullptr)
+        return;
+
+    electrodelayout->setSelectedId(layout->getIntAttribute("selected"), dontSendNotification);
+
+    // Restore from the compiled layout in the background; a newer user selection wins
+    Component::SafePointer<RateViewerEditor> safeThis(this);
+
+    layoutLoader = std::make_unique<ElectrodeLayoutLoader>(
+        layout->getStringAttribute("path"),
+        layout->getStringAttribute("hash"),
+        [safeThis](std::shared_ptr<ElectrodeLayout> loaded)
+        {
+            if (safeThis == nullptr)
+                return;
+
+            if (safeThis->currentLayout == nullptr
+                || safeThis->currentLayout->sourceFile == loaded->sourceFile)
+                safeThis->applyLayout(loaded);
+        });
+
+    layoutLoader->startThread();
 }
 
 void RateViewerEditor::filenameComponentChanged(FilenameComponent* fileComponentThatHasChanged)
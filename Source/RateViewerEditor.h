@@ -29,6 +29,8 @@
 #include <fstream>
 #include <map>
 
+#include "ElectrodeLayout.h"
+
 /** 
 	The editor for the VisualizerPlugin
 
@@ -54,19 +56,31 @@ class RateViewerEditor : public VisualizerEditor,
 		void comboBoxChanged(ComboBox* comboBox) override;
 		void buttonClicked(Button* button) override;
 		void filenameComponentChanged(FilenameComponent* fileComponentThatHasChanged) override;
+
+		/** Writes the layout list, the selected layout and the canvas view */
+		void saveViewerState(XmlElement* xml);
+
+		/** Restores the state written by saveViewerState(); the layout itself is loaded in the background */
+		void loadViewerState(XmlElement* xml);
 		
    	private:
         std::ofstream debugLogFile;
         void writeToDebugLog(const String& message);
         void initDebugLog();
         void loadYamlFile(const String& filename);
+        void applyLayout(std::shared_ptr<ElectrodeLayout> layout);
 
 		std::unique_ptr<ComboBox> electrodelayout;
-		std::unique_ptr<ToggleButton> heatmapToggle;
 		std::unique_ptr<TextButton> loadFileButton;
 		std::unique_ptr<FilenameComponent> fileChooser;
 		std::map<int, String> layoutFiles;
 
+		std::shared_ptr<ElectrodeLayout> currentLayout;
+		std::unique_ptr<ElectrodeLayoutLoader> layoutLoader;
+
+		/** Zoom and pan loaded before the canvas was created */
+		std::unique_ptr<XmlElement> pendingViewState;
+
 		/** Generates an assertion if this class leaks */
 		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RateViewerEditor);
 };
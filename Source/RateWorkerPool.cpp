@@ -0,0 +1,128 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RateWorkerPool.h"
+
+#include <algorithm>
+
+RateWorkerPool::RateWorkerPool(int numWorkers)
+    : queues(new ShardQueue[numWorkers + 1])
+{
+    for (int i = 0; i < numWorkers; i++)
+        workers.emplace_back([this, i] { workerLoop(i + 1); });
+}
+
+RateWorkerPool::~RateWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shouldExit = true;
+    }
+
+    startCondition.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+int RateWorkerPool::getDefaultNumWorkers()
+{
+    const int numCores = (int) std::thread::hardware_concurrency();
+
+    // Leave room for the acquisition and message threads
+    return std::max(1, std::min(8, numCores - 2));
+}
+
+void RateWorkerPool::run(int numShards, const std::function<void(int)>& job)
+{
+    const int numParticipants = (int) workers.size() + 1;
+
+    for (int p = 0; p < numParticipants; p++)
+    {
+        queues[p].next.store(numShards * p / numParticipants, std::memory_order_relaxed);
+        queues[p].end = numShards * (p + 1) / numParticipants;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        activeWorkers = (int) workers.size();
+        ++generation;
+    }
+
+    startCondition.notify_all();
+
+    runShards(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+    currentJob = nullptr;
+}
+
+void RateWorkerPool::workerLoop(int participant)
+{
+    unsigned lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&] { return shouldExit || generation != lastGeneration; });
+
+            if (shouldExit)
+                return;
+
+            lastGeneration = generation;
+        }
+
+        runShards(participant);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --activeWorkers;
+        }
+
+        doneCondition.notify_one();
+    }
+}
+
+void RateWorkerPool::runShards(int participant)
+{
+    const int numParticipants = (int) workers.size() + 1;
+
+    for (int offset = 0; offset < numParticipants; offset++)
+    {
+        // Own queue first, then steal from the others in turn
+        ShardQueue& queue = queues[(participant + offset) % numParticipants];
+
+        while (true)
+        {
+            const int shard = queue.next.fetch_add(1, std::memory_order_relaxed);
+
+            if (shard >= queue.end)
+                break;
+
+            (*currentJob)(shard);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RATEWORKERPOOL_H_INCLUDED
+#define RATEWORKERPOOL_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/** Size used to keep data written by different threads on separate cache lines */
+constexpr std::size_t cacheLineSize = 64;
+
+/** Allocator for per-channel arrays whose shards must start on a cache line */
+template <typename T>
+struct CacheAlignedAllocator
+{
+	using value_type = T;
+
+	CacheAlignedAllocator() = default;
+
+	template <typename U>
+	CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(cacheLineSize)));
+	}
+
+	void deallocate(T* p, std::size_t)
+	{
+		::operator delete(p, std::align_val_t(cacheLineSize));
+	}
+
+	template <typename U>
+	bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+/**
+	A small set of persistent threads that run a frame's shards.
+
+	Shards are dealt out as contiguous runs, one run per participant
+	(the workers plus the calling thread). Each participant drains its
+	own run first and then steals from the others, so a slow shard does
+	not hold up the frame. run() returns once every shard has finished.
+*/
+class RateWorkerPool
+{
+public:
+	/** Starts the worker threads */
+	explicit RateWorkerPool(int numWorkers);
+
+	/** Stops and joins the worker threads */
+	~RateWorkerPool();
+
+	/** Calls job(shardIndex) for each shard in [0, numShards) and waits for all of them */
+	void run(int numShards, const std::function<void(int)>& job);
+
+	/** Number of worker threads, not counting the caller */
+	int getNumWorkers() const { return (int) workers.size(); }
+
+	/** Worker count suited to this machine */
+	static int getDefaultNumWorkers();
+
+private:
+	struct alignas(cacheLineSize) ShardQueue
+	{
+		std::atomic<int> next { 0 };
+		int end = 0;
+	};
+
+	void workerLoop(int participant);
+	void runShards(int participant);
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<ShardQueue[]> queues;
+
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+
+	const std::function<void(int)>* currentJob = nullptr;
+	unsigned generation = 0;
+	int activeWorkers = 0;
+	bool shouldExit = false;
+
+	RateWorkerPool(const RateWorkerPool&) = delete;
+	RateWorkerPool& operator=(const RateWorkerPool&) = delete;
+};
+
+#endif // RATEWORKERPOOL_H_INCLUDED
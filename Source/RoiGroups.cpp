@@ -0,0 +1,341 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RoiGroups.h"
+
+float RoiGroups::sumMasked(const float* values, int numValues, const ChannelBitset& members)
+{
+    const std::vector<uint64_t>& words = members.getWords();
+    const int numWords = jmin((int) words.size(), (numValues + 63) / 64);
+
+    float sum = 0.0f;
+
+    for (int w = 0; w < numWords; ++w)
+    {
+        uint64_t word = words[(size_t) w];
+        const int base = w * 64;
+
+        if (word == ~(uint64_t) 0 && base + 64 <= numValues)
+        {
+            // Independent partial sums, so the run is not one long dependency chain
+            float partial[8] = {};
+
+            for (int i = 0; i < 64; i += 8)
+                for (int j = 0; j < 8; ++j)
+                    partial[j] += values[base + i + j];
+
+            for (float p : partial)
+                sum += p;
+
+            continue;
+        }
+
+        for (; word != 0; word &= word - 1)
+        {
+            const int ch = base + BitOps::countTrailingZeros64(word);
+
+            if (ch < numValues)
+                sum += values[ch];
+        }
+    }
+
+    return sum;
+}
+
+int RoiGroups::countMasked(int numValues, const ChannelBitset& members)
+{
+    const std::vector<uint64_t>& words = members.getWords();
+    const int numWords = jmin((int) words.size(), (numValues + 63) / 64);
+
+    int total = 0;
+
+    for (int w = 0; w < numWords; ++w)
+    {
+        uint64_t word = words[(size_t) w];
+
+        // The last word may reach past numValues
+        const int valid = numValues - w * 64;
+
+        if (valid < 64)
+            word &= ((uint64_t) 1 << valid) - 1;
+
+        total += BitOps::popcount64(word);
+    }
+
+    return total;
+}
+
+String RoiGroups::formatChannels(const ChannelBitset& members)
+{
+    String text;
+    int runStart = -1;
+    int previous = -2;
+
+    auto closeRun = [&]()
+    {
+        if (runStart < 0)
+            return;
+
+        if (text.isNotEmpty())
+            text << ",";
+
+        text << runStart;
+
+        if (previous > runStart)
+            text << "-" << previous;
+    };
+
+    members.forEach([&](int ch)
+    {
+        if (ch != previous + 1)
+        {
+            closeRun();
+            runStart = ch;
+        }
+
+        previous = ch;
+    });
+
+    closeRun();
+    return text;
+}
+
+ChannelBitset RoiGroups::parseChannels(const String& text)
+{
+    std::vector<std::pair<int, int>> runs;
+    int highest = -1;
+
+    for (const auto& token : StringArray::fromTokens(text, ",", ""))
+    {
+        const String item = token.trim();
+
+        if (item.isEmpty())
+            continue;
+
+        const int first = item.upToFirstOccurrenceOf("-", false, false).getIntValue();
+        const int last = item.contains("-") ? item.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+
+        if (first < 0 || last < first)
+            continue;
+
+        runs.emplace_back(first, last);
+        highest = jmax(highest, last);
+    }
+
+    ChannelBitset members;
+    members.resize(highest + 1);
+
+    for (const auto& run : runs)
+        for (int ch = run.first; ch <= run.second; ++ch)
+            members.set(ch);
+
+    return members;
+}
+
+void RoiGroups::setNumChannels(int numChannels_)
+{
+    numChannels = numChannels_;
+
+    for (auto& group : groups)
+    {
+        if (group.members.size() >= numChannels)
+            continue;
+
+        ChannelBitset grown;
+        grown.resize(numChannels);
+        group.members.forEach([&grown](int ch) { grown.set(ch); });
+        group.members = std::move(grown);
+    }
+
+    // Synchrony updates run during acquisition and list at most every channel
+    memberScratch.reserve((size_t) numChannels);
+
+    updateChannelGroups();
+}
+
+int RoiGroups::addGroup(const String& name, const ChannelBitset& members)
+{
+    if ((int) groups.size() >= maxGroups || ! members.any())
+        return -1;
+
+    Group group;
+    group.name = name;
+    group.members.resize(jmax(numChannels, members.size()));
+    members.forEach([&group](int ch) { group.members.set(ch); });
+
+    groups.push_back(std::move(group));
+    aggregates.emplace_back();
+    updateChannelGroups();
+
+    return (int) groups.size() - 1;
+}
+
+void RoiGroups::removeGroup(int group)
+{
+    if (group < 0 || group >= (int) groups.size())
+        return;
+
+    groups.erase(groups.begin() + group);
+    aggregates.erase(aggregates.begin() + group);
+    updateChannelGroups();
+}
+
+String RoiGroups::getDefaultName() const
+{
+    for (int n = 1;; ++n)
+    {
+        const String name = "ROI " + String(n);
+        bool used = false;
+
+        for (const auto& group : groups)
+            used = used || group.name == name;
+
+        if (! used)
+            return name;
+    }
+}
+
+void RoiGroups::setAlarmThresholds(const std::vector<ChannelAlarmMonitor::Group>& alarmGroups)
+{
+    // The alarm groups are built from these groups, in the same order
+    for (size_t g = 0; g < groups.size() && g < alarmGroups.size(); ++g)
+        if (alarmGroups[g].name == groups[g].name)
+            groups[g].alarmThreshold = alarmGroups[g].threshold;
+}
+
+std::vector<ChannelAlarmMonitor::Group> RoiGroups::toAlarmGroups() const
+{
+    std::vector<ChannelAlarmMonitor::Group> alarmGroups(groups.size());
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        alarmGroups[g].name = groups[g].name;
+        alarmGroups[g].threshold = groups[g].alarmThreshold;
+        alarmGroups[g].channels.reserve((size_t) groups[g].members.count());
+        groups[g].members.forEach([&](int ch) { alarmGroups[g].channels.push_back(ch); });
+    }
+
+    return alarmGroups;
+}
+
+void RoiGroups::saveToXml(XmlElement* parent) const
+{
+    for (const auto& group : groups)
+    {
+        XmlElement* element = parent->createNewChildElement("ROI_GROUP");
+        element->setAttribute("name", group.name);
+        element->setAttribute("channels", formatChannels(group.members));
+
+        if (group.alarmThreshold > 0.0f)
+            element->setAttribute("alarm_rate", group.alarmThreshold);
+    }
+}
+
+void RoiGroups::loadFromXml(const XmlElement* parent)
+{
+    groups.clear();
+    aggregates.clear();
+
+    for (auto* element : parent->getChildWithTagNameIterator("ROI_GROUP"))
+    {
+        const int index = addGroup(element->getStringAttribute("name", getDefaultName()),
+                                   parseChannels(element->getStringAttribute("channels")));
+
+        if (index >= 0)
+            groups[(size_t) index].alarmThreshold = (float) element->getDoubleAttribute("alarm_rate", 0.0);
+    }
+}
+
+void RoiGroups::resetCounts()
+{
+    for (auto& aggregate : aggregates)
+        aggregate.spikeCount = 0;
+}
+
+void RoiGroups::updateRates(const float* rates, int numRates)
+{
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        Aggregate& aggregate = aggregates[g];
+
+        // Members without a rate (kept from a larger channel count) do not dilute the mean
+        const int numWithRates = countMasked(numRates, groups[g].members);
+
+        aggregate.totalRate = sumMasked(rates, numRates, groups[g].members);
+        aggregate.meanRate = numWithRates > 0 ? aggregate.totalRate / numWithRates : 0.0f;
+    }
+}
+
+void RoiGroups::updateSynchrony(const std::vector<float>& matrix, int n)
+{
+    std::vector<int>& members = memberScratch;
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        members.clear();
+        groups[g].members.forEach([&](int ch)
+        {
+            if (ch < n)
+                members.push_back(ch);
+        });
+
+        double sum = 0.0;
+        int pairs = 0;
+
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            const float* row = matrix.data() + (size_t) members[i] * n;
+
+            for (size_t j = i + 1; j < members.size(); ++j)
+                sum += row[members[j]];
+
+            pairs += (int) (members.size() - i - 1);
+        }
+
+        aggregates[g].synchrony = pairs > 0 ? (float) (sum / pairs) : -1.0f;
+    }
+}
+
+void RoiGroups::clearSynchrony()
+{
+    for (auto& aggregate : aggregates)
+        aggregate.synchrony = -1.0f;
+}
+
+void RoiGroups::updateChannelGroups()
+{
+    version++;
+
+    int size = numChannels;
+
+    for (const auto& group : groups)
+        size = jmax(size, group.members.size());
+
+    channelGroups.assign((size_t) size, 0);
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        aggregates[g].numMembers = countMasked(numChannels, groups[g].members);
+        groups[g].members.forEach([&](int ch) { channelGroups[(size_t) ch] |= (uint64) 1 << g; });
+    }
+}
@@ -0,0 +1,140 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ROIGROUPS_H_INCLUDED
+#define ROIGROUPS_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "ChannelAlarmMonitor.h"
+#include "ChannelBitset.h"
+
+#include <vector>
+
+/**
+	Operator-defined groups of electrodes (wells, shanks, regions) and
+	their aggregate activity.
+
+	Each group is a bitset over electrode slots. Rates are summed per group
+	on every rate update, with full 64-channel words summed as contiguous
+	runs, so a well laid out on consecutive channels costs a plain loop.
+	Spike counts are kept per group as spikes are drained, using a mask of
+	the groups each channel belongs to. All of it runs on the message thread.
+*/
+class RoiGroups
+{
+public:
+	/** Matches the alarm monitor, so every group can raise an alarm */
+	static constexpr int maxGroups = ChannelAlarmMonitor::maxGroups;
+
+	struct Group
+	{
+		String name;
+		ChannelBitset members;
+		float alarmThreshold = 0.0f;   // Hz, 0 = off
+	};
+
+	struct Aggregate
+	{
+		int numMembers = 0;         // members below the channel count
+		float meanRate = 0.0f;      // Hz per electrode
+		float totalRate = 0.0f;     // spikes per second over the group
+		uint64 spikeCount = 0;      // since acquisition started
+		float synchrony = -1.0f;    // mean pairwise synchrony; negative when not computed
+	};
+
+	/** Sum of values[ch] over the members below numValues */
+	static float sumMasked(const float* values, int numValues, const ChannelBitset& members);
+
+	/** Number of members below numValues */
+	static int countMasked(int numValues, const ChannelBitset& members);
+
+	/** Formats members as a compact list such as "0-15,32" */
+	static String formatChannels(const ChannelBitset& members);
+
+	/** Parses a list written by formatChannels() */
+	static ChannelBitset parseChannels(const String& text);
+
+	/** Members are kept when the count shrinks, so groups survive a layout change */
+	void setNumChannels(int numChannels);
+
+	int getNumGroups() const { return (int) groups.size(); }
+
+	/** Changes whenever a group is added, removed or loaded */
+	uint32 getVersion() const { return version; }
+	const Group& getGroup(int group) const { return groups[(size_t) group]; }
+	const Aggregate& getAggregate(int group) const { return aggregates[(size_t) group]; }
+
+	/** Returns the new group's index, or -1 if it is empty or maxGroups exist already */
+	int addGroup(const String& name, const ChannelBitset& members);
+	void removeGroup(int group);
+
+	/** "ROI n" with the lowest unused n */
+	String getDefaultName() const;
+
+	/** Copies thresholds edited through the alarm monitor back into the groups */
+	void setAlarmThresholds(const std::vector<ChannelAlarmMonitor::Group>& alarmGroups);
+
+	/** The groups as alarm monitor groups */
+	std::vector<ChannelAlarmMonitor::Group> toAlarmGroups() const;
+
+	/** Writes one ROI_GROUP element per group */
+	void saveToXml(XmlElement* parent) const;
+
+	/** Replaces the groups with the ROI_GROUP elements under parent */
+	void loadFromXml(const XmlElement* parent);
+
+	/** Clears the spike counts; called when acquisition starts */
+	void resetCounts();
+
+	void addSpikes(int channel, int count)
+	{
+		if (channel < 0 || channel >= (int) channelGroups.size())
+			return;
+
+		for (uint64 mask = channelGroups[(size_t) channel]; mask != 0; mask &= mask - 1)
+			aggregates[(size_t) BitOps::countTrailingZeros64(mask)].spikeCount += (uint64) count;
+	}
+
+	/** Recomputes every group's rate aggregates */
+	void updateRates(const float* rates, int numRates);
+
+	/** Recomputes every group's mean pairwise synchrony from an n x n matrix */
+	void updateSynchrony(const std::vector<float>& matrix, int n);
+	void clearSynchrony();
+
+private:
+	/** Rebuilds the per-channel group masks after the groups change */
+	void updateChannelGroups();
+
+	int numChannels = 0;
+	uint32 version = 0;
+	std::vector<Group> groups;
+	std::vector<Aggregate> aggregates;
+	std::vector<uint64> channelGroups;   // bit g is set if the channel is in group g
+
+	/** Reused by updateSynchrony() */
+	std::vector<int> memberScratch;
+};
+
+#endif // ROIGROUPS_H_INCLUDED
@@ -0,0 +1,221 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SharedRateEngine.h"
+
+#include <algorithm>
+#include <map>
+
+class SharedRateEngine::Config
+{
+public:
+    Config(int windowMs_, int numChannels)
+        : windowMs(windowMs_),
+          estimator(RateKernels::createRateEstimator(windowMs_))
+    {
+        estimator->setNumChannels(numChannels);
+        rates.assign((size_t) numChannels, 0.0f);
+
+        shardJob = [this](int shard)
+        {
+            const int begin = shard * channelsPerShard;
+            const int end = jmin((int) rates.size(), begin + channelsPerShard);
+            estimator->computeRates(rates.data(), begin, end);
+        };
+    }
+
+    const int windowMs;
+    int numSubscribers = 0;
+
+    std::unique_ptr<RateKernels::RateEstimator> estimator;
+    CacheAlignedVector<float> rates;
+    std::function<void(int)> shardJob;
+
+    /** What the rates were computed for */
+    int64 computedBin = -1;
+    uint64 computedVersion = 0;
+};
+
+namespace
+{
+    CriticalSection registryLock;
+
+    std::map<String, std::weak_ptr<SharedRateEngine>>& getRegistry()
+    {
+        static std::map<String, std::weak_ptr<SharedRateEngine>> registry;
+        return registry;
+    }
+}
+
+std::shared_ptr<SharedRateEngine> SharedRateEngine::getEngine(const String& key, int numChannels)
+{
+    const ScopedLock lock(registryLock);
+
+    auto& registry = getRegistry();
+
+    if (auto existing = registry[key].lock())
+        if (existing->getNumChannels() == numChannels)
+            return existing;
+
+    auto engine = std::make_shared<SharedRateEngine>(key, numChannels);
+    registry[key] = engine;
+    return engine;
+}
+
+String SharedRateEngine::makeKey(const StringArray& channelIdentities)
+{
+    return String(channelIdentities.size()) + ":" + channelIdentities.joinIntoString("|");
+}
+
+SharedRateEngine::SharedRateEngine(const String& key_, int numChannels_)
+    : key(key_), numChannels(numChannels_)
+{
+}
+
+SharedRateEngine::~SharedRateEngine()
+{
+    const ScopedLock lock(registryLock);
+
+    auto& registry = getRegistry();
+    auto entry = registry.find(key);
+
+    // A replacement engine may already hold the key
+    if (entry != registry.end() && entry->second.expired())
+        registry.erase(entry);
+}
+
+void SharedRateEngine::addFeeder(const void* newFeeder)
+{
+    if (feeder == nullptr)
+        feeder = newFeeder;
+}
+
+void SharedRateEngine::removeFeeder(const void* oldFeeder)
+{
+    // The next viewer to deliver a spike takes over
+    if (feeder == oldFeeder)
+        feeder = nullptr;
+}
+
+void SharedRateEngine::addSpikes(const void* spikeFeeder, int channel, int count, int64 timeMs)
+{
+    // Every viewer receives the same spikes, so only one of them is counted. A viewer that
+    // stopped delivering (disabled or bypassed) hands over once the others are a bin ahead.
+    if (spikeFeeder != feeder)
+    {
+        if (feeder != nullptr && timeMs - lastFedMs <= feederHandoverMs)
+            return;
+
+        feeder = spikeFeeder;
+    }
+
+    lastFedMs = jmax(lastFedMs, timeMs);
+
+    for (auto& config : configs)
+    {
+        config->estimator->advanceTo(timeMs);
+        config->estimator->addSpikes(channel, (float) count);
+    }
+
+    spikeVersion++;
+}
+
+std::unique_ptr<SharedRateEngine::Subscription> SharedRateEngine::subscribe(int windowMs)
+{
+    return std::make_unique<Subscription>(shared_from_this(), windowMs);
+}
+
+SharedRateEngine::Config* SharedRateEngine::acquireConfig(int windowMs)
+{
+    for (auto& config : configs)
+    {
+        if (config->windowMs == windowMs)
+        {
+            config->numSubscribers++;
+            return config.get();
+        }
+    }
+
+    configs.push_back(std::make_unique<Config>(windowMs, numChannels));
+    configs.back()->numSubscribers = 1;
+    return configs.back().get();
+}
+
+void SharedRateEngine::releaseConfig(Config* config)
+{
+    if (--config->numSubscribers > 0)
+        return;
+
+    configs.erase(std::remove_if(configs.begin(), configs.end(),
+                                 [config](const std::unique_ptr<Config>& c) { return c.get() == config; }),
+                  configs.end());
+}
+
+const float* SharedRateEngine::computeRates(Config& config, int64 timeMs, RateWorkerPool* pool)
+{
+    config.estimator->advanceTo(timeMs);
+
+    // Rates only change when a bin closes or spikes arrive
+    const int64 bin = timeMs / config.estimator->getBinMs();
+
+    if (bin == config.computedBin && spikeVersion == config.computedVersion)
+        return config.rates.data();
+
+    const int numShards = (numChannels + channelsPerShard - 1) / channelsPerShard;
+
+    if (pool != nullptr && numChannels >= parallelChannelThreshold)
+        pool->run(numShards, config.shardJob);
+    else
+        config.estimator->computeRates(config.rates.data(), 0, numChannels);
+
+    config.computedBin = bin;
+    config.computedVersion = spikeVersion;
+
+    return config.rates.data();
+}
+
+SharedRateEngine::Subscription::Subscription(std::shared_ptr<SharedRateEngine> engine_, int windowMs)
+    : engine(std::move(engine_)),
+      config(engine->acquireConfig(windowMs))
+{
+}
+
+SharedRateEngine::Subscription::~Subscription()
+{
+    engine->releaseConfig(config);
+}
+
+int SharedRateEngine::Subscription::getWindowMs() const
+{
+    return config->windowMs;
+}
+
+int SharedRateEngine::Subscription::getBinMs() const
+{
+    return config->estimator->getBinMs();
+}
+
+const float* SharedRateEngine::Subscription::getRates(int64 timeMs, RateWorkerPool* pool)
+{
+    return engine->computeRates(*config, timeMs, pool);
+}
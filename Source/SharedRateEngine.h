@@ -0,0 +1,133 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SHAREDRATEENGINE_H_INCLUDED
+#define SHAREDRATEENGINE_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "RateKernels.h"
+#include "RateWorkerPool.h"
+
+#include <memory>
+#include <vector>
+
+/**
+	Rate estimates shared by every Rate Viewer that sees the same spike
+	channels.
+
+	Engines are kept in a registry inside the plugin library, keyed by the
+	spike channels' source, stream and name and by the chain of processors
+	upstream of the viewer, and live as long as a viewer holds them. Viewers
+	sharing an engine therefore receive identical spikes. Each registers as
+	a feeder, but only one of them feeds spikes in at a time, so every spike
+	is counted once. When the feeding viewer falls silent for longer than
+	feederHandoverMs while another still delivers spikes (it was disabled,
+	bypassed or removed), the other one takes over. Canvases subscribe
+	with their window. Subscribers with the same window share one
+	estimator, and its rates are computed at most once per bin and per
+	batch of new spikes. The cost therefore grows with the number of
+	distinct windows, not with the number of open viewers.
+
+	Everything here runs on the message thread, except the rate shards,
+	which may run on the caller's worker pool.
+*/
+class SharedRateEngine : public std::enable_shared_from_this<SharedRateEngine>
+{
+public:
+	/** Channel counts above which rates are computed on the worker pool */
+	static constexpr int parallelChannelThreshold = 1024;
+	static constexpr int channelsPerShard = 256;
+
+	/** Silence after which another feeder takes over, in ms */
+	static constexpr int feederHandoverMs = 100;
+
+	/** Returns the engine for key, creating it if no viewer holds one */
+	static std::shared_ptr<SharedRateEngine> getEngine(const String& key, int numChannels);
+
+	/** Key for a list of spike channel identities, in global index order */
+	static String makeKey(const StringArray& channelIdentities);
+
+	SharedRateEngine(const String& key, int numChannels);
+	~SharedRateEngine();
+
+	const String& getKey() const { return key; }
+	int getNumChannels() const { return numChannels; }
+
+	/** Viewers register while they hold the engine; the first one feeds it */
+	void addFeeder(const void* feeder);
+	void removeFeeder(const void* feeder);
+
+	/** Adds spikes received at timeMs (Time::getMillisecondCounter()) to every
+		estimator, if feeder is the one feeding the engine or takes over */
+	void addSpikes(const void* feeder, int channel, int count, int64 timeMs);
+
+	class Config;
+
+	/** A canvas or publisher's hold on the shared estimator for its window */
+	class Subscription
+	{
+	public:
+		Subscription(std::shared_ptr<SharedRateEngine> engine, int windowMs);
+		~Subscription();
+
+		const SharedRateEngine* getEngine() const { return engine.get(); }
+		int getWindowMs() const;
+		int getBinMs() const;
+
+		/** Rates in Hz for every engine channel at timeMs, computed once for all subscribers */
+		const float* getRates(int64 timeMs, RateWorkerPool* pool);
+
+	private:
+		std::shared_ptr<SharedRateEngine> engine;
+		Config* config;
+
+		JUCE_DECLARE_NON_COPYABLE(Subscription);
+	};
+
+	std::unique_ptr<Subscription> subscribe(int windowMs);
+
+	/** Number of estimators currently kept (distinct windows) */
+	int getNumConfigs() const { return (int) configs.size(); }
+
+private:
+	Config* acquireConfig(int windowMs);
+	void releaseConfig(Config* config);
+
+	const float* computeRates(Config& config, int64 timeMs, RateWorkerPool* pool);
+
+	const String key;
+	const int numChannels;
+
+	/** The viewer whose spikes are counted, and the time of the last spike it fed */
+	const void* feeder = nullptr;
+	int64 lastFedMs = 0;
+	std::vector<std::unique_ptr<Config>> configs;
+
+	/** Changes whenever spikes are added */
+	uint64 spikeVersion = 0;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedRateEngine);
+};
+
+#endif // SHAREDRATEENGINE_H_INCLUDED
@@ -0,0 +1,77 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SpikeCountCoalescer.h"
+
+void SpikeCountCoalescer::setNumChannels(int numChannels_)
+{
+    numChannels = numChannels_;
+
+    openCounts.assign(numChannels, 0);
+    recordCounts.assign((size_t) maxRecords * numChannels, 0);
+    recordBins.assign(maxRecords, 0);
+
+    reset(0);
+}
+
+void SpikeCountCoalescer::reset(uint32 nowMs)
+{
+    std::fill(openCounts.begin(), openCounts.end(), 0);
+    openHasSpikes = false;
+    openBin = nowMs / binMs;
+
+    records.reset();
+}
+
+bool SpikeCountCoalescer::advanceTo(uint32 nowMs)
+{
+    const uint32 bin = nowMs / binMs;
+
+    if (bin == openBin)
+        return false;
+
+    if (! openHasSpikes)
+    {
+        openBin = bin;
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    records.prepareToWrite(1, start1, size1, start2, size2);
+
+    // Ring full: keep counting into the open bin until the reader catches up
+    if (size1 == 0)
+        return false;
+
+    uint32* record = recordCounts.data() + (size_t) start1 * numChannels;
+    std::copy(openCounts.begin(), openCounts.end(), record);
+    std::fill(openCounts.begin(), openCounts.end(), 0);
+    recordBins[(size_t) start1] = openBin;
+
+    records.finishedWrite(1);
+
+    openHasSpikes = false;
+    openBin = bin;
+
+    return true;
+}
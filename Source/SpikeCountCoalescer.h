@@ -0,0 +1,108 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SPIKECOUNTCOALESCER_H_INCLUDED
+#define SPIKECOUNTCOALESCER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+/**
+	Hands spikes from the processing thread to the message thread as
+	per-bin channel counts instead of one event per spike.
+
+	The processing thread only increments a counter per spike. When the
+	clock leaves the open bin, its counts are copied into a preallocated
+	record ring, so the hand-off costs O(channels) per bin however many
+	spikes arrive. Spike times are lost below the bin width. If the
+	message thread falls behind and the ring fills, the open bin keeps
+	counting and is handed over later, so no spike is dropped.
+*/
+class SpikeCountCoalescer
+{
+public:
+	static constexpr int binMs = 10;
+	static constexpr int maxRecords = 64;
+
+	/** Resizes every buffer; only call while acquisition is stopped */
+	void setNumChannels(int numChannels);
+	int getNumChannels() const { return numChannels; }
+
+	/** Discards the open bin and any pending records */
+	void reset(uint32 nowMs);
+
+	/** Processing thread: counts one spike in the open bin */
+	void addSpike(int channel)
+	{
+		if (channel < 0 || channel >= numChannels)
+			return;
+
+		openCounts[channel]++;
+		openHasSpikes = true;
+	}
+
+	/** Processing thread: closes the open bin once nowMs has left it.
+		Returns true if a record was handed over. */
+	bool advanceTo(uint32 nowMs);
+
+	/** Message thread: calls fn(channel, count, binStartMs) for every non-zero
+		count in the pending records, oldest first */
+	template <class Fn>
+	void drain(Fn&& fn)
+	{
+		int start1, size1, start2, size2;
+		records.prepareToRead(records.getNumReady(), start1, size1, start2, size2);
+
+		auto drainRange = [&](int start, int size)
+		{
+			for (int r = start; r < start + size; ++r)
+			{
+				const uint32* counts = recordCounts.data() + (size_t) r * numChannels;
+				const uint32 binStartMs = recordBins[(size_t) r] * binMs;
+
+				for (int ch = 0; ch < numChannels; ++ch)
+					if (counts[ch] > 0)
+						fn(ch, (int) counts[ch], binStartMs);
+			}
+		};
+
+		drainRange(start1, size1);
+		drainRange(start2, size2);
+
+		records.finishedRead(size1 + size2);
+	}
+
+private:
+	int numChannels = 0;
+
+	std::vector<uint32> openCounts;
+	bool openHasSpikes = false;
+	uint32 openBin = 0;
+
+	AbstractFifo records{ maxRecords };
+	std::vector<uint32> recordCounts;
+	std::vector<uint32> recordBins;
+};
+
+#endif // SPIKECOUNTCOALESCER_H_INCLUDED
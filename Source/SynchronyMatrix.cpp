@@ -0,0 +1,229 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SynchronyMatrix.h"
+#include "ChannelBitset.h"
+
+#include <algorithm>
+#include <cmath>
+
+SynchronyMatrix::SynchronyMatrix()
+    : Thread("Synchrony Matrix")
+{
+}
+
+SynchronyMatrix::~SynchronyMatrix()
+{
+    stopThread(1000);
+}
+
+void SynchronyMatrix::setNumChannels(int numChannels_)
+{
+    const SpinLock::ScopedLockType lock(trainLock);
+
+    numChannels = jmin(numChannels_, maxChannels);
+    trains.assign((size_t) numChannels * numWords, 0);
+    headWord = -1;
+    latestSpikeMs = 0.0;
+}
+
+void SynchronyMatrix::setEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled == enabled.load())
+        return;
+
+    enabled = shouldBeEnabled;
+
+    if (shouldBeEnabled)
+    {
+        reset();
+        startThread();
+    }
+    else
+    {
+        stopThread(1000);
+    }
+}
+
+void SynchronyMatrix::reset()
+{
+    const SpinLock::ScopedLockType lock(trainLock);
+
+    std::fill(trains.begin(), trains.end(), 0);
+    headWord = -1;
+    latestSpikeMs = 0.0;
+}
+
+void SynchronyMatrix::addSpike(int channel, double timeMs)
+{
+    if (! enabled.load(std::memory_order_relaxed) || timeMs < 0.0)
+        return;
+
+    const int64 bin = (int64) (timeMs / binMs);
+    const int64 word = bin >> 6;
+
+    const SpinLock::ScopedLockType lock(trainLock);
+
+    if (channel < 0 || channel >= numChannels)
+        return;
+
+    if (word <= headWord - numWords)
+        return;
+
+    advanceHead(word);
+
+    if (timeMs >= latestSpikeMs)
+    {
+        latestSpikeMs = timeMs;
+        latestSpikeWallMs = Time::getMillisecondCounterHiRes();
+    }
+
+    trains[(size_t) channel * numWords + (size_t) (word % numWords)] |= (uint64) 1 << (bin & 63);
+}
+
+void SynchronyMatrix::advanceHead(int64 word)
+{
+    if (word <= headWord)
+        return;
+
+    // Words entering the window are cleared for every channel
+    const int64 firstNewWord = jmax(headWord + 1, word - numWords + 1);
+
+    for (int64 w = firstNewWord; w <= word; ++w)
+    {
+        const int slot = (int) (w % numWords);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            trains[(size_t) ch * numWords + slot] = 0;
+    }
+
+    headWord = word;
+}
+
+bool SynchronyMatrix::getResult(uint32& lastVersion, std::vector<float>& matrix, std::vector<Link>& links, int& numResultChannels) const
+{
+    const ScopedLock lock(resultLock);
+
+    if (resultVersion == lastVersion)
+        return false;
+
+    lastVersion = resultVersion;
+    matrix = resultMatrix;
+    links = resultLinks;
+    numResultChannels = resultChannels;
+    return true;
+}
+
+void SynchronyMatrix::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(updateIntervalMs);
+
+        if (threadShouldExit())
+            break;
+
+        compute();
+    }
+}
+
+void SynchronyMatrix::compute()
+{
+    int n;
+
+    {
+        const SpinLock::ScopedLockType lock(trainLock);
+
+        // Without new spikes the window still slides, so old coincidences age out
+        if (headWord >= 0)
+        {
+            const double nowMs = latestSpikeMs + (Time::getMillisecondCounterHiRes() - latestSpikeWallMs);
+            advanceHead((int64) (nowMs / binMs) >> 6);
+        }
+
+        n = numChannels;
+        snapshot.assign(trains.begin(), trains.end());
+    }
+
+    spikeCounts.assign(n, 0);
+    activeChannels.clear();
+
+    for (int ch = 0; ch < n; ++ch)
+    {
+        const uint64* train = snapshot.data() + (size_t) ch * numWords;
+
+        for (int w = 0; w < numWords; ++w)
+            spikeCounts[ch] += BitOps::popcount64(train[w]);
+
+        if (spikeCounts[ch] > 0)
+            activeChannels.push_back(ch);
+    }
+
+    workMatrix.assign((size_t) n * n, 0.0f);
+    workLinks.clear();
+
+    // Only channels that spiked in the window can coincide
+    for (size_t i = 0; i < activeChannels.size(); ++i)
+    {
+        const int a = activeChannels[i];
+        const uint64* trainA = snapshot.data() + (size_t) a * numWords;
+
+        workMatrix[(size_t) a * n + a] = 1.0f;
+
+        for (size_t j = i + 1; j < activeChannels.size(); ++j)
+        {
+            const int b = activeChannels[j];
+            const uint64* trainB = snapshot.data() + (size_t) b * numWords;
+
+            int coincidences = 0;
+
+            for (int w = 0; w < numWords; ++w)
+                coincidences += BitOps::popcount64(trainA[w] & trainB[w]);
+
+            if (coincidences == 0)
+                continue;
+
+            const float strength = coincidences / std::sqrt((float) spikeCounts[a] * spikeCounts[b]);
+
+            workMatrix[(size_t) a * n + b] = strength;
+            workMatrix[(size_t) b * n + a] = strength;
+
+            if (coincidences >= minCoincidences)
+                workLinks.push_back({ a, b, strength });
+        }
+    }
+
+    if ((int) workLinks.size() > maxLinks)
+    {
+        std::nth_element(workLinks.begin(), workLinks.begin() + maxLinks, workLinks.end(),
+                         [](const Link& x, const Link& y) { return x.strength > y.strength; });
+        workLinks.resize(maxLinks);
+    }
+
+    const ScopedLock lock(resultLock);
+
+    std::swap(resultMatrix, workMatrix);
+    std::swap(resultLinks, workLinks);
+    resultChannels = n;
+    resultVersion++;
+}
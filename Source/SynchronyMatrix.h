@@ -0,0 +1,128 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SYNCHRONYMATRIX_H_INCLUDED
+#define SYNCHRONYMATRIX_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <vector>
+
+/**
+	Pairwise spike synchrony over a sliding window.
+
+	Each channel's spikes are binned into bits, numWords 64-bit words per
+	channel, used as a ring: when a new word starts it is cleared for every
+	channel, so the window slides one word at a time. Spike times are
+	synchronised across streams, and the worker also slides the window
+	through silent periods, extrapolating from the newest spike. A worker thread
+	snapshots the words a few times per second and, for every pair of
+	channels that spiked, counts coincident bins with AND and popcount.
+	Each count is normalised by the geometric mean of the two spike counts,
+	giving 1 for identical trains and 0 for trains that never coincide.
+
+	The matrix and the strongest links are published under a lock with a
+	version number.
+*/
+class SynchronyMatrix : private Thread
+{
+public:
+	/** Width of a coincidence bin */
+	static constexpr int binMs = 5;
+
+	/** Window of 8 x 64 bins (2.56 s), sliding by 64 bins (320 ms) */
+	static constexpr int numWords = 8;
+
+	static constexpr int maxChannels = 1024;
+	static constexpr int updateIntervalMs = 250;
+
+	/** Strongest pairs reported as links */
+	static constexpr int maxLinks = 256;
+
+	/** Pairs with fewer coincidences are not reported as links */
+	static constexpr int minCoincidences = 3;
+
+	struct Link
+	{
+		int a;
+		int b;
+		float strength;
+	};
+
+	SynchronyMatrix();
+	~SynchronyMatrix();
+
+	/** Channels above maxChannels are ignored */
+	void setNumChannels(int numChannels);
+
+	/** Starts or stops the worker; spikes are ignored while disabled */
+	void setEnabled(bool shouldBeEnabled);
+	bool isEnabled() const { return enabled.load(); }
+
+	/** Clears every spike train; called when acquisition starts */
+	void reset();
+
+	/** Sets the spike's bit; timeMs is on the time base shared by all streams (message thread) */
+	void addSpike(int channel, double timeMs);
+
+	/** Copies the latest result if it is newer than lastVersion, and updates lastVersion */
+	bool getResult(uint32& lastVersion, std::vector<float>& matrix, std::vector<Link>& links, int& numChannels) const;
+
+private:
+	void run() override;
+
+	/** Computes one matrix from a snapshot of the trains */
+	void compute();
+
+	/** Clears the words entering the window up to word; trainLock must be held */
+	void advanceHead(int64 word);
+
+	std::atomic<bool> enabled { false };
+
+	SpinLock trainLock;
+	int numChannels = 0;
+	std::vector<uint64> trains;   // numWords per channel
+	int64 headWord = -1;
+
+	/** Newest spike time and the wall clock when it arrived, to slide the window without spikes */
+	double latestSpikeMs = 0.0;
+	double latestSpikeWallMs = 0.0;
+
+	// Worker-only buffers, reused between updates
+	std::vector<uint64> snapshot;
+	std::vector<int> spikeCounts;
+	std::vector<int> activeChannels;
+	std::vector<float> workMatrix;
+	std::vector<Link> workLinks;
+
+	CriticalSection resultLock;
+	std::vector<float> resultMatrix;
+	std::vector<Link> resultLinks;
+	int resultChannels = 0;
+	uint32 resultVersion = 0;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynchronyMatrix);
+};
+
+#endif // SYNCHRONYMATRIX_H_INCLUDED
@@ -0,0 +1,71 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SynchronyMatrixView.h"
+
+SynchronyMatrixView::SynchronyMatrixView()
+{
+    setInterceptsMouseClicks(false, false);
+}
+
+void SynchronyMatrixView::setMatrix(const std::vector<float>& matrix, int numChannels, const std::array<uint32, 256>& colourLut)
+{
+    if (numChannels <= 0 || (int) matrix.size() < numChannels * numChannels)
+    {
+        image = Image();
+        repaint();
+        return;
+    }
+
+    if (image.getWidth() != numChannels)
+        image = Image(Image::ARGB, numChannels, numChannels, false);
+
+    Image::BitmapData pixels(image, Image::BitmapData::writeOnly);
+    const float lastIndex = (float) (colourLut.size() - 1);
+
+    for (int row = 0; row < numChannels; ++row)
+    {
+        uint32* line = reinterpret_cast<uint32*>(pixels.getLinePointer(row));
+        const float* values = matrix.data() + (size_t) row * numChannels;
+
+        for (int column = 0; column < numChannels; ++column)
+            line[column] = colourLut[(size_t) jlimit(0.0f, lastIndex, values[column] * lastIndex)];
+    }
+
+    repaint();
+}
+
+void SynchronyMatrixView::paint(Graphics& g)
+{
+    g.fillAll(Colours::black.withAlpha(0.85f));
+
+    if (image.isValid())
+    {
+        // Pairs stay sharp when scaled up
+        g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+        g.drawImage(image, getLocalBounds().reduced(2).toFloat(), RectanglePlacement::stretchToFit);
+    }
+
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds());
+}
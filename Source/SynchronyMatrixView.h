@@ -0,0 +1,52 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SYNCHRONYMATRIXVIEW_H_INCLUDED
+#define SYNCHRONYMATRIXVIEW_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <vector>
+
+/**
+	Draws an N x N synchrony matrix, one pixel per pair, scaled to the
+	component's bounds.
+*/
+class SynchronyMatrixView : public Component
+{
+public:
+	SynchronyMatrixView();
+
+	/** Recolours the matrix image; values from 0 to 1 */
+	void setMatrix(const std::vector<float>& matrix, int numChannels, const std::array<uint32, 256>& colourLut);
+
+	void paint(Graphics& g) override;
+
+private:
+	Image image;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynchronyMatrixView);
+};
+
+#endif // SYNCHRONYMATRIXVIEW_H_INCLUDED
@@ -0,0 +1,144 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TimingWheel.h"
+
+#include <algorithm>
+
+TimingWheel::TimingWheel(int tickMs_)
+    : tickMs(std::max(1, tickMs_)),
+      slotHead(2 * wheelSize, -1)
+{
+}
+
+void TimingWheel::setNumTimers(int numTimers)
+{
+    std::fill(slotHead.begin(), slotHead.end(), -1);
+
+    next.assign(numTimers, -1);
+    prev.assign(numTimers, -1);
+    slotOf.assign(numTimers, -1);
+    expiryTick.assign(numTimers, 0);
+}
+
+void TimingWheel::schedule(int id, int64_t expiryMs)
+{
+    if (id < 0 || id >= (int) slotOf.size())
+        return;
+
+    if (slotOf[id] >= 0)
+        unlink(id);
+
+    // Rounded up so a timer never fires before its expiry time
+    const int64_t tick = (expiryMs + tickMs - 1) / tickMs;
+
+    // The wheel starts at the first advance(); until then, time starts here
+    if (currentTick < 0)
+        currentTick = tick;
+
+    expiryTick[id] = tick;
+    insert(id);
+}
+
+void TimingWheel::cancel(int id)
+{
+    if (id >= 0 && id < (int) slotOf.size() && slotOf[id] >= 0)
+        unlink(id);
+}
+
+void TimingWheel::insert(int id)
+{
+    // Timers already due fire on the next tick
+    const int64_t due = std::max(expiryTick[id], currentTick + 1);
+
+    // Keep outer timers within one outer revolution so slots never alias
+    const int64_t delta = std::min<int64_t>(due - currentTick, (wheelSize - 1) * wheelSize);
+    const int64_t tick = currentTick + delta;
+    expiryTick[id] = tick;
+
+    int slot;
+
+    if (delta < wheelSize)
+        slot = (int) (tick & (wheelSize - 1));
+    else
+        slot = wheelSize + (int) ((tick >> wheelShift) & (wheelSize - 1));
+
+    slotOf[id] = slot;
+    prev[id] = -1;
+    next[id] = slotHead[slot];
+
+    if (slotHead[slot] >= 0)
+        prev[slotHead[slot]] = id;
+
+    slotHead[slot] = id;
+}
+
+void TimingWheel::unlink(int id)
+{
+    const int slot = slotOf[id];
+
+    if (prev[id] >= 0)
+        next[prev[id]] = next[id];
+    else
+        slotHead[slot] = next[id];
+
+    if (next[id] >= 0)
+        prev[next[id]] = prev[id];
+
+    slotOf[id] = -1;
+}
+
+void TimingWheel::cascade()
+{
+    // Called at the start of an inner revolution: the matching outer slot moves in
+    const int slot = wheelSize + (int) ((currentTick >> wheelShift) & (wheelSize - 1));
+
+    int id = slotHead[slot];
+    slotHead[slot] = -1;
+
+    while (id >= 0)
+    {
+        const int following = next[id];
+        slotOf[id] = -1;
+
+        // Due at the current tick: insert() would push it one tick late
+        if (expiryTick[id] == currentTick)
+        {
+            const int innerSlot = (int) (currentTick & (wheelSize - 1));
+            slotOf[id] = innerSlot;
+            prev[id] = -1;
+            next[id] = slotHead[innerSlot];
+
+            if (slotHead[innerSlot] >= 0)
+                prev[slotHead[innerSlot]] = id;
+
+            slotHead[innerSlot] = id;
+        }
+        else
+        {
+            insert(id);
+        }
+
+        id = following;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TIMINGWHEEL_H_INCLUDED
+#define TIMINGWHEEL_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+/**
+	Two-level hierarchical timing wheel with one timer per channel.
+
+	The inner wheel has 64 slots of tickMs each; the outer wheel has 64
+	slots spanning a full inner revolution each, so timers up to
+	63 * 64 ticks ahead are held exactly (later ones are clamped). Timers
+	are linked in place through per-channel arrays, so scheduling,
+	re-arming and expiring never allocate, and advancing only touches
+	the slots that come due.
+*/
+class TimingWheel
+{
+public:
+	explicit TimingWheel(int tickMs = 8);
+
+	/** Resizes the wheel for numTimers channels and cancels every timer */
+	void setNumTimers(int numTimers);
+
+	/** Arms (or re-arms) a channel's timer to fire at expiryMs */
+	void schedule(int id, int64_t expiryMs);
+
+	/** Disarms a channel's timer */
+	void cancel(int id);
+
+	bool isScheduled(int id) const { return slotOf[id] >= 0; }
+
+	/** Moves the wheel to nowMs, calling onExpired(id) for every timer that came due */
+	template <typename Fn>
+	void advance(int64_t nowMs, Fn&& onExpired)
+	{
+		const int64_t nowTick = nowMs / tickMs;
+
+		if (currentTick < 0 || nowTick - currentTick >= wheelSize * wheelSize)
+		{
+			// Nothing can still be pending this far ahead
+			if (currentTick >= 0)
+				for (int slot = 0; slot < 2 * wheelSize; ++slot)
+					expireSlot(slot, onExpired);
+
+			currentTick = nowTick;
+			return;
+		}
+
+		while (currentTick < nowTick)
+		{
+			++currentTick;
+
+			if ((currentTick & (wheelSize - 1)) == 0)
+				cascade();
+
+			expireSlot((int) (currentTick & (wheelSize - 1)), onExpired);
+		}
+	}
+
+private:
+	static constexpr int wheelSize = 64;
+	static constexpr int wheelShift = 6;
+
+	template <typename Fn>
+	void expireSlot(int slot, Fn& onExpired)
+	{
+		while (slotHead[slot] >= 0)
+		{
+			const int id = slotHead[slot];
+			unlink(id);
+			onExpired(id);
+		}
+	}
+
+	void insert(int id);
+	void unlink(int id);
+	void cascade();
+
+	int tickMs;
+	int64_t currentTick = -1;
+
+	std::vector<int> slotHead;      // 2 * wheelSize slots: inner then outer
+	std::vector<int> next;
+	std::vector<int> prev;
+	std::vector<int> slotOf;        // -1 when not scheduled
+	std::vector<int64_t> expiryTick;
+};
+
+#endif // TIMINGWHEEL_H_INCLUDED
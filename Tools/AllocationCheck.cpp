@@ -0,0 +1,370 @@
+/*
+------------------------------------------------------------------
+
+This file is part of a plugin for the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+	Standalone check that the classes on the acquisition paths never touch
+	the heap once they are set up: the processing thread, the processor's
+	spike drain in handleAsyncUpdate() and the canvas refresh, minus the
+	drawing.
+
+	Built by CMake as allocation_check when RATEVIEWER_COUNT_ALLOCATIONS is
+	on, and registered with CTest. Each case runs inside a ScopedCount and
+	fails if it allocated or freed anything; the last case allocates on
+	purpose and fails if the counter missed it, so a counter that is not
+	actually linked in cannot pass.
+*/
+
+#include "AllocationCounter.h"
+#include "AmplitudeStatistics.h"
+#include "ChannelAlarmMonitor.h"
+#include "FramePacer.h"
+#include "IsiStatistics.h"
+#include "PeriStimulusHistogram.h"
+#include "RateKernels.h"
+#include "RoiGroups.h"
+#include "SharedRateEngine.h"
+#include "SpikeCountCoalescer.h"
+#include "SynchronyMatrix.h"
+#include "TimingWheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+#if ! RATEVIEWER_COUNT_ALLOCATIONS
+ #error "allocation_check needs RATEVIEWER_COUNT_ALLOCATIONS=1"
+#endif
+
+namespace
+{
+    constexpr int numChannels = 1024;
+    constexpr int numSpikes = 200000;
+
+    int numFailures = 0;
+
+    /** Runs fn inside a ScopedCount and checks whether it touched the heap */
+    template <typename Fn>
+    void check(const char* name, bool shouldAllocate, Fn&& fn)
+    {
+        const std::uint64_t allocationsBefore = AllocationCounter::getAllocationCount();
+        const std::uint64_t freesBefore = AllocationCounter::getFreeCount();
+
+        {
+            const AllocationCounter::ScopedCount countAllocations;
+            fn();
+        }
+
+        const std::uint64_t allocations = AllocationCounter::getAllocationCount() - allocationsBefore;
+        const std::uint64_t frees = AllocationCounter::getFreeCount() - freesBefore;
+
+        const bool passed = shouldAllocate ? (allocations > 0 && frees > 0) : (allocations == 0 && frees == 0);
+
+        if (! passed)
+            numFailures++;
+
+        std::printf("%-56s %8llu allocations %8llu frees   %s\n",
+                    name, (unsigned long long) allocations, (unsigned long long) frees, passed ? "ok" : "FAILED");
+    }
+
+    /** Cheap deterministic channel sequence */
+    int nextChannel(uint32_t& state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (int) ((state >> 8) % numChannels);
+    }
+}
+
+int main()
+{
+    uint32_t random = 1;
+
+    // Set-up may allocate; only the acquisition-time calls are counted
+
+    SpikeCountCoalescer coalescer;
+    coalescer.setNumChannels(numChannels);
+    coalescer.reset(0);
+
+    check("SpikeCountCoalescer add/advance/drain", false, [&]
+    {
+        uint64_t drained = 0;
+
+        for (int i = 0; i < numSpikes; ++i)
+        {
+            coalescer.addSpike(nextChannel(random));
+
+            if (i % 100 == 0)
+            {
+                coalescer.advanceTo((uint32) (i / 20));
+                coalescer.drain([&](int, int count, uint32) { drained += (uint64_t) count; });
+            }
+        }
+    });
+
+    auto fixedEstimator = RateKernels::createRateEstimator(1000);
+    auto runtimeEstimator = RateKernels::createRateEstimator(1234);
+    std::vector<float> rates(numChannels);
+
+    for (auto* estimator : { fixedEstimator.get(), runtimeEstimator.get() })
+    {
+        estimator->setNumChannels(numChannels);
+
+        check(estimator == fixedEstimator.get() ? "RateEstimator (specialised kernel)" : "RateEstimator (runtime kernel)", false, [&]
+        {
+            for (int i = 0; i < numSpikes; ++i)
+            {
+                estimator->advanceTo(i / 20);
+                estimator->addSpikes(nextChannel(random), 1.0f);
+
+                if (i % 1000 == 0)
+                    estimator->computeRates(rates.data(), 0, numChannels);
+            }
+        });
+    }
+
+    TimingWheel wheel;
+    wheel.setNumTimers(numChannels);
+
+    check("TimingWheel schedule/advance", false, [&]
+    {
+        int expired = 0;
+
+        for (int i = 0; i < numSpikes; ++i)
+        {
+            const int64_t now = i / 20;
+            wheel.schedule(nextChannel(random), now + 200 + i % 500);
+
+            if (i % 50 == 0)
+                wheel.advance(now, [&](int) { expired++; });
+        }
+    });
+
+    ChannelAlarmMonitor alarms;
+    alarms.setNumChannels(numChannels);
+
+    std::map<int, std::pair<float, float>> positions;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        positions[ch] = { (float) (ch % 32), (float) (ch / 32) };
+
+    alarms.setNeighbours(positions);
+
+    ChannelAlarmMonitor::Settings settings;
+    settings.alarmRate = 20.0f;
+    settings.silentMs = 1000;
+    settings.runawayFactor = 5.0f;
+    settings.channelThresholds.assign(numChannels, 0.0f);
+    settings.groups.push_back({ "group", { 0, 1, 2, 3 }, 10.0f });
+    alarms.setSettings(settings);
+    alarms.reset(0);
+
+    // Settings keep changing on another thread, as they do from the editor
+    std::atomic<bool> stopWriter { false };
+
+    std::thread writer([&]
+    {
+        ChannelAlarmMonitor::Settings changed = settings;
+
+        while (! stopWriter.load())
+        {
+            changed.alarmRate = changed.alarmRate == 20.0f ? 30.0f : 20.0f;
+            alarms.setSettings(changed);
+            alarms.setNeighbours(positions);
+        }
+    });
+
+    check("ChannelAlarmMonitor add/advance (settings churn)", false, [&]
+    {
+        for (int i = 0; i < numSpikes; ++i)
+        {
+            alarms.addSpike(nextChannel(random));
+
+            if (i % 100 == 0)
+                alarms.advanceTo(i / 10);
+        }
+    });
+
+    // As AlarmPanel::updateRows() polls it, into a copy sized on the first poll
+    ChannelAlarmMonitor::Settings panelSettings;
+    alarms.copySettings(panelSettings);
+    uint32 panelSettingsVersion = alarms.getSettingsVersion();
+
+    check("AlarmPanel settings poll (settings churn)", false, [&]
+    {
+        for (int i = 0; i < 10000; ++i)
+        {
+            const uint32 version = alarms.getSettingsVersion();
+
+            if (version != panelSettingsVersion)
+            {
+                panelSettingsVersion = version;
+                alarms.copySettings(panelSettings);
+            }
+        }
+    });
+
+    stopWriter = true;
+    writer.join();
+
+    // What RateViewer::handleAsyncUpdate() feeds with each drained spike
+    IsiStatistics isiStatistics;
+    isiStatistics.setNumChannels(numChannels);
+
+    AmplitudeStatistics amplitudeStatistics;
+    amplitudeStatistics.setNumChannels(numChannels);
+
+    SynchronyMatrix synchrony;
+    synchrony.setNumChannels(numChannels);
+    synchrony.setEnabled(true);
+
+    RoiGroups roiGroups;
+    roiGroups.setNumChannels(numChannels);
+
+    ChannelBitset members;
+    members.resize(numChannels);
+
+    for (int ch = 0; ch < numChannels; ch += 3)
+        members.set(ch);
+
+    roiGroups.addGroup("group", members);
+
+    const int feeder = 0;
+    auto rateEngine = SharedRateEngine::getEngine("allocation_check", numChannels);
+    rateEngine->addFeeder(&feeder);
+
+    auto rateSubscription = rateEngine->subscribe(1000);
+    RateWorkerPool workerPool(RateWorkerPool::getDefaultNumWorkers());
+
+    PeriStimulusHistogram psth;
+    psth.setNumChannels(numChannels);
+    psth.setSettings({});
+
+    auto drainSpike = [&](int i)
+    {
+        const int channel = nextChannel(random);
+        const double timeMs = i / 20.0;
+
+        isiStatistics.addSpike(channel, (int64) i * 1500, 30000.0f);
+        synchrony.addSpike(channel, timeMs);
+        amplitudeStatistics.addAmplitude(channel, 50.0f + (float) (i % 100));
+        roiGroups.addSpikes(channel, 1);
+        rateEngine->addSpikes(&feeder, channel, 1, (int64) timeMs);
+    };
+
+    check("Spike drain (ISI, synchrony, amplitude, groups, rates)", false, [&]
+    {
+        for (int i = 0; i < numSpikes; ++i)
+            drainSpike(i);
+    });
+
+    check("PeriStimulusHistogram trigger/spike", false, [&]
+    {
+        for (int i = 0; i < numSpikes; ++i)
+        {
+            const double timeMs = i / 20.0;
+            psth.addSpike(nextChannel(random), timeMs);
+
+            if (i % 5000 == 0)
+                psth.addTrigger(0, timeMs);
+        }
+    });
+
+    // The canvas's copies are sized by the first result after a configuration change
+    std::vector<float> synchronyMatrix;
+    std::vector<SynchronyMatrix::Link> synchronyLinks;
+    synchronyLinks.reserve(SynchronyMatrix::maxLinks);
+    int numSynchronyChannels = 0;
+    uint32 synchronyVersion = 0;
+
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        if (synchrony.getResult(synchronyVersion, synchronyMatrix, synchronyLinks, numSynchronyChannels))
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    PeriStimulusHistogram::Result psthResult;
+    uint32 psthVersion = 0;
+    psth.getResult(psthVersion, psthResult);
+
+    FramePacer framePacer;
+    TimingWheel flashWheel;
+    flashWheel.setNumTimers(numChannels);
+
+    check("Canvas refresh (rates, groups, synchrony, PSTH)", false, [&]
+    {
+        for (int frame = 0; frame < 300; ++frame)
+        {
+            // Spikes keep arriving between frames, so every frame has new rates
+            for (int i = 0; i < 500; ++i)
+                drainSpike(frame * 500 + i);
+
+            const int64 now = frame * 33;
+            const float* rates = rateSubscription->getRates(now, &workerPool);
+
+            roiGroups.updateRates(rates, numChannels);
+
+            if (synchrony.getResult(synchronyVersion, synchronyMatrix, synchronyLinks, numSynchronyChannels))
+                roiGroups.updateSynchrony(synchronyMatrix, numSynchronyChannels);
+
+            psth.getResult(psthVersion, psthResult);
+
+            flashWheel.schedule(frame % numChannels, now + 200);
+            flashWheel.advance(now, [](int) {});
+
+            framePacer.tick(FramePacer::Activity::spiking, 1.0);
+        }
+
+        // The frames above may all fall between two synchrony updates
+        for (int attempt = 0; attempt < 100; ++attempt)
+        {
+            if (synchrony.getResult(synchronyVersion, synchronyMatrix, synchronyLinks, numSynchronyChannels))
+            {
+                roiGroups.updateSynchrony(synchronyMatrix, numSynchronyChannels);
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+
+    synchrony.setEnabled(false);
+    rateSubscription.reset();
+    rateEngine->removeFeeder(&feeder);
+
+    // Must be seen, or the counter is not actually replacing new and delete
+    check("deliberate allocation (must be counted)", true, []
+    {
+        std::vector<int>* volatile escaped = new std::vector<int>(16, 1);
+        delete escaped;
+    });
+
+    if (numFailures > 0)
+        std::printf("%d case(s) failed\n", numFailures);
+
+    return numFailures > 0 ? 1 : 0;
+}